@@ -5,17 +5,1602 @@
 // includes
 // --------
 
-#include <cassert>   // assert
-#include <cstddef>   // ptrdiff_t, size_t
-#include <new>       // bad_alloc, new
-#include <stdexcept> // invalid_argument
+#include <algorithm>   // fill, max, min
+#include <atomic>      // atomic, memory_order_acquire, memory_order_relaxed, memory_order_seq_cst
+#include <cassert>     // assert
+#include <climits>     // INT_MAX
+#include <cstdlib>     // abs
+#include <cstddef>     // ptrdiff_t, size_t
+#include <cstdint>     // uint32_t, uint64_t
+#include <mutex>       // lock_guard, mutex
+#include <new>         // bad_alloc, new
+#include <ostream>     // ostream
+#include <set>         // set
+#include <stdexcept>   // invalid_argument
+#include <type_traits> // false_type, true_type
+#include <vector>      // vector
+
+#include <sys/mman.h> // madvise, mmap, munmap
+#include <unistd.h>   // sysconf
+
+// ALLOCATOR_CHECK picks what a build with assertions checks:
+// 0, nothing
+// 1, the sentinels of a block and of both its neighbours, on every allocate and deallocate
+// 2, that and every block, every ALLOCATOR_CHECK_EVERY calls of an Allocator
+// ALLOCATOR_CANARY adds an int, or as many as keep payloads aligned, to the end of every used block, checked on deallocate
+// ALLOCATOR_POISON fills every free block, checked on allocate, to catch writes after free
+
+#ifndef ALLOCATOR_CHECK
+#define ALLOCATOR_CHECK 1
+#endif
+
+#ifndef ALLOCATOR_CHECK_EVERY
+#define ALLOCATOR_CHECK_EVERY 1024
+#endif
+
+template <typename T, std::size_t N, std::size_t S = 16>
+class ConcurrentAllocator;
+
+// ----------
+// Statistics
+// ----------
+
+/**
+ * what an Allocator reports about itself, see Allocator::stats
+ * the counters are kept by Counters, and stay 0 without ALLOCATOR_STATS
+ * the rest is taken by a walk over the blocks whenever stats is called
+ * sizes are in bytes of payload, the sentinels are not counted
+ */
+struct Statistics {
+    // --------
+    // counters
+    // --------
+
+    std::size_t allocations;   // blocks allocated
+    std::size_t frees;         // blocks freed
+    std::size_t live;          // bytes allocated and not freed yet
+    std::size_t peak;          // the most live has been
+    std::size_t histogram[32]; // allocations by floor(log2(bytes requested))
+
+    // ----
+    // walk
+    // ----
+
+    std::size_t in_use;      // bytes in used blocks
+    std::size_t used_blocks;
+    std::size_t free;        // bytes in free blocks
+    std::size_t free_blocks;
+    std::size_t largest;     // bytes in the largest free block
+    std::size_t top;         // bytes up to the end of the last used block, summed over the regions
+
+    Statistics () :
+            allocations (0),
+            frees       (0),
+            live        (0),
+            peak        (0),
+            histogram   (),
+            in_use      (0),
+            used_blocks (0),
+            free        (0),
+            free_blocks (0),
+            largest     (0),
+            top         (0) {}
+
+    /**
+     * O(1) in space
+     * O(1) in time
+     * 1 - largest / free, 0 with all the free bytes in one block, near 1 with
+     * them in many small ones, so that a request far below free can still fail
+     */
+    double fragmentation () const {
+        return (free == 0) ? 0 : 1 - static_cast<double>(largest) / free;}
+
+    /**
+     * O(1) in space
+     * O(1) in time
+     * count an allocation of a block of s bytes for a request of r bytes
+     */
+    void allocated (std::size_t r, std::size_t s) {
+        int c = 0;
+        while (r >>= 1)
+            ++c;
+        ++allocations;
+        ++histogram[c];
+        live += s;
+        peak  = std::max(peak, live);}
+
+    /**
+     * O(1) in space
+     * O(1) in time
+     * count the free of k blocks of s bytes in all
+     */
+    void freed (std::size_t s, std::size_t k = 1) {
+        frees += k;
+        live  -= s;}
+
+    /**
+     * O(1) in space
+     * O(1) in time
+     * write every field as name value, space separated, or as the members of a JSON object
+     */
+    void print (std::ostream& w, bool json) const {
+        const std::size_t v[] = {allocations, frees, live, peak, in_use, used_blocks, free, free_blocks, largest, top};
+        const char*       n[] = {"allocations", "frees", "live", "peak", "in_use", "used_blocks", "free", "free_blocks", "largest", "top"};
+        const char*       q   = json ? "\"" : "";
+        const char*       e   = json ? ": "  : " ";
+        for (int i = 0; i != 10; ++i)
+            w << q << n[i] << q << e << v[i] << (json ? ", " : " ");
+        w << q << "fragmentation" << q << e << fragmentation() << (json ? ", " : " ");
+        w << q << "histogram" << q << e << (json ? "[" : "");
+        for (int c = 0; c != 32; ++c)
+            w << (c == 0 ? "" : (json ? ", " : ",")) << histogram[c];
+        w << (json ? "]" : "");}};
+
+// --------
+// Counters
+// --------
+
+/**
+ * the counters of Statistics, which an allocator inherits privately
+ * they only count if ALLOCATOR_STATS is defined, at a few adds per allocate
+ * and deallocate; otherwise the class is empty and takes no space in the allocator
+ */
+#ifdef ALLOCATOR_STATS
+class Counters {
+    private:
+        Statistics counters;
+
+    public:
+        void allocated (std::size_t r, std::size_t s) {
+            counters.allocated(r, s);}
+
+        void freed (std::size_t s, std::size_t k = 1) {
+            counters.freed(s, k);}
+
+        Statistics counted () const {
+            return counters;}};
+#else
+class Counters {
+    public:
+        void allocated (std::size_t, std::size_t) {}
+
+        void freed (std::size_t, std::size_t = 1) {}
+
+        Statistics counted () const {
+            return Statistics();}};
+#endif
+
+// --------
+// Sentinel
+// --------
+
+/**
+ * reads and writes the int sentinels and links that Blocks and the placement
+ * policies keep inside the region
+ */
+struct Sentinel {
+    /**
+    * return value of an address location
+    */
+    static int get_val(const char* ptr) {
+        return *reinterpret_cast<const int*> (ptr);}
+
+    /**
+    * set value of an address location
+    */
+    static void set_val(char* ptr, int a) {
+        int* set_ptr = (int*) (ptr);
+        *set_ptr = a;}};
+
+// -----------
+// SizeClasses
+// -----------
+
+/**
+ * a placement policy that keeps a free list per power of two payload size,
+ * linked through the free blocks themselves: a free block with room for two
+ * ints keeps the payload offsets of the next and the previous block of its
+ * class, 0 for none, at the start of its payload
+ * smaller free blocks stay off the lists until they coalesce
+ * K picks how a list is ordered and so which block find returns:
+ *   good fit,                new blocks in front, the first that fits
+ *   best fit,                by size, the smallest that fits
+ *   address-ordered best fit by size and then address, the lowest of the smallest
+ * since every block of a class above that of s fits, only the class of s is
+ * ever searched, the others just give up their first block
+ */
+template <int K>
+class SizeClasses : private Sentinel {
+    private:
+        // ----
+        // data
+        // ----
+
+        static const int classes = 32;
+
+        unsigned int bits;          // bit c is set if list c is not empty
+        int          head[classes]; // the payload offset of the first block of each list
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * return the list of a block with s bytes of payload, floor(log2(s))
+         */
+        static int size_class (int s) {
+            int c = 0;
+            while (s >>= 1)
+                ++c;
+            return c;}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * return whether the free block at payload offset o goes after the one
+         * at payload offset q, with s and r their sizes, on a list ordered by K
+         */
+        static bool after (int s, int o, int r, int q) {
+            return (K != 0) && ((s > r) || ((K == 2) && (s == r) && (o > q)));}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        SizeClasses () :
+                bits (0),
+                head () {}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void init () {
+            bits = 0;
+            std::fill(head, head + classes, 0);}
+
+        /**
+         * O(1) in space
+         * O(1) in time for good fit, O(n) in the length of its list otherwise
+         * put the free block with sentinel b on its list
+         */
+        void link (char* a, char* b) {
+            const int s = get_val(b);
+            assert(s > 0);
+            if (s < static_cast<int>(2 * sizeof(int)))
+                return;
+            const int c    = size_class(s);
+            const int o    = static_cast<int>(b - a + sizeof(int));
+            int       prev = 0;
+            int       next = head[c];
+            while ((next != 0) && after(s, o, get_val(a + next - sizeof(int)), next)) {
+                prev = next;
+                next = get_val(a + next);}
+            set_val(b + sizeof(int),               next);
+            set_val(b + sizeof(int) + sizeof(int), prev);
+            if (prev != 0)
+                set_val(a + prev, o);
+            else
+                head[c] = o;
+            if (next != 0)
+                set_val(a + next + sizeof(int), o);
+            bits |= 1U << c;}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * take the free block with sentinel b off its list
+         */
+        void unlink (char* a, char* b) {
+            const int s = get_val(b);
+            assert(s > 0);
+            if (s < static_cast<int>(2 * sizeof(int)))
+                return;
+            const int c    = size_class(s);
+            const int next = get_val(b + sizeof(int));
+            const int prev = get_val(b + sizeof(int) + sizeof(int));
+            if (prev != 0)
+                set_val(a + prev, next);
+            else
+                head[c] = next;
+            if (next != 0)
+                set_val(a + next + sizeof(int), prev);
+            if (head[c] == 0)
+                bits &= ~(1U << c);}
+
+        /**
+         * O(1) in space
+         * O(1) in time, amortized, unless the list of s holds many blocks smaller than s
+         * return the sentinel of a free block with at least s bytes of payload, 0 if there is none
+         * the first that fits on the list of s, then the first block of the lowest nonempty list above it
+         */
+        char* find (char* a, std::size_t, int s) {
+            const int c = size_class(s);
+            for (int o = head[c]; o != 0; o = get_val(a + o))
+                if (get_val(a + o - sizeof(int)) >= s)
+                    return a + o - sizeof(int);
+            unsigned int above = (c + 1 < classes) ? (bits >> (c + 1)) : 0;
+            if (above == 0)
+                return 0;
+            int d = c + 1;
+            while ((above & 1) == 0) {
+                above >>= 1;
+                ++d;}
+            return a + head[d] - sizeof(int);}};
+
+typedef SizeClasses<0> GoodFit;
+typedef SizeClasses<1> BestFit;
+typedef SizeClasses<2> AddressOrderedBestFit;
+
+// --------
+// FirstFit
+// --------
+
+/**
+ * a placement policy that keeps no index and walks the blocks from the start
+ * of the region to the first free one that fits, past every used block and
+ * every fragment too small on the way
+ */
+class FirstFit : private Sentinel {
+    public:
+        void init   () {}
+        void link   (char*, char*) {}
+        void unlink (char*, char*) {}
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * return the sentinel of the first free block with at least s bytes of payload, 0 if there is none
+         */
+        char* find (char* a, std::size_t n, int s) {
+            for (char* b = a; b != a + n; b += std::abs(get_val(b)) + (2 * sizeof(int)))
+                if (get_val(b) >= s)
+                    return b;
+            return 0;}};
+
+// -------
+// NextFit
+// -------
+
+/**
+ * FirstFit from a roving offset rather than from the start, wrapping around
+ * the rover stays on the block find last returned, and moves to the start of
+ * any free block that coalesces over it
+ */
+class NextFit : private Sentinel {
+    private:
+        // ----
+        // data
+        // ----
+
+        std::size_t rover; // the offset of a block sentinel
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        NextFit () :
+                rover (0) {}
+
+        void init () {
+            rover = 0;}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void link (char* a, char* b) {
+            const std::size_t o = b - a;
+            if ((rover >= o) && (rover < o + get_val(b) + (2 * sizeof(int))))
+                rover = o;}
+
+        void unlink (char*, char*) {}
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * return the sentinel of the first free block with at least s bytes of payload
+         * from the rover on, 0 if there is none
+         */
+        char* find (char* a, std::size_t n, int s) {
+            for (int pass = 0; pass != 2; ++pass) {
+                char* b = pass ? a : a + rover;
+                char* e = pass ? a + rover : a + n;
+                for (; b != e; b += std::abs(get_val(b)) + (2 * sizeof(int)))
+                    if (get_val(b) >= s) {
+                        rover = b - a;
+                        return b;}}
+            return 0;}};
+
+// ------
+// Blocks
+// ------
+
+/**
+ * the blocks of one region of memory, [a, a + n)
+ * every block is an int sentinel, its payload, and the same sentinel again,
+ * positive for a free block and negative for a used one
+ * P, the placement policy, indexes the free blocks and picks the one
+ * allocate splits: GoodFit, BestFit, AddressOrderedBestFit, FirstFit or NextFit
+ * the region is passed to every call rather than kept, so that a region
+ * that moves with its owner, like the a[N] of a copied Allocator, needs no fixing up
+ */
+template <typename T, typename P = GoodFit>
+class Blocks : public Sentinel {
+    public:
+        #ifdef ALLOCATOR_CANARY
+        // bytes added to every request, a multiple of the alignment payloads of
+        // Ts keep, 8 when sizeof(T) is a multiple of 8, so that no payload moves off it
+        static const std::size_t slack = (sizeof(T) % 8 != 0) ? sizeof(int) : (alignof(T) > 8) ? alignof(T) : 8;
+        #else
+        static const std::size_t slack = 0;
+        #endif
+
+    private:
+        // ----
+        // data
+        // ----
+
+        static const int           canary = 0x5AFEB10C;
+        static const unsigned char poison = 0xDB;
+
+        P index;
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * write the canary of the used block with sentinel b, if there is one,
+         * into every int of the slack at the end of its payload
+         */
+        static void mark (char* b) {
+            #ifdef ALLOCATOR_CANARY
+            for (std::size_t k = 0; k != slack; k += sizeof(int))
+                set_val(b - get_val(b) - k, canary);
+            #else
+            (void) b;
+            #endif
+            }
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * poison the payload of the free block with sentinel b, past its links, if it is poisoned
+         */
+        static void fill (char* b) {
+            #ifdef ALLOCATOR_POISON
+            if (get_val(b) > static_cast<int>(2 * sizeof(int)))
+                std::fill(b + (3 * sizeof(int)), b + sizeof(int) + get_val(b), poison);
+            #else
+            (void) b;
+            #endif
+            }
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * return whether the first s bytes of the payload of the block with sentinel b,
+         * past the links, are still poisoned, true if nothing is
+         */
+        static bool filled (const char* b, int s) {
+            #ifdef ALLOCATOR_POISON
+            for (const char* p = b + (3 * sizeof(int)); p < b + sizeof(int) + s; ++p)
+                if (static_cast<unsigned char>(*p) != poison)
+                    return false;
+            #else
+            (void) b;
+            (void) s;
+            #endif
+            return true;}
+
+        /**
+         * O(1) in space
+         * O(n) in time with ALLOCATOR_POISON, O(1) otherwise
+         * return whether the canary of the used block with sentinel b, or the
+         * poison of the free one, is intact
+         */
+        static bool intact (const char* b) {
+            #ifdef ALLOCATOR_CANARY
+            if (get_val(b) < 0)
+                for (std::size_t k = 0; k != slack; k += sizeof(int))
+                    if (get_val(b - get_val(b) - k) != canary)
+                        return false;
+            #endif
+            return (get_val(b) < 0) || filled(b, get_val(b));}
+
+        /**
+         * push the free block with sentinel b onto the index
+         */
+        void link (char* a, char* b) {
+            index.link(a, b);}
+
+        /**
+         * take the free block with sentinel b off the index
+         */
+        void unlink (char* a, char* b) {
+            index.unlink(a, b);}
+
+            // ---------
+            // coalesce
+            // ---------
+
+            /**
+            * concatenate 2 free blocks together, neither of them on a list
+            * left is the end sentinel of the first, right the start sentinel of the second
+            * return the start sentinel of the new block
+            */
+        static char* coalesce_blocks(char* left, char* right) {
+            assert(get_val(left) > 0);
+            assert(get_val(right) > 0);
+
+            char* ptr = left;
+            int new_size = get_val(left) + get_val(right) + 2 * sizeof(int);
+
+            ptr = ptr - get_val(left) - sizeof(int);
+            char* _b = ptr;
+            set_val(ptr, new_size);
+
+            ptr = ptr + new_size + sizeof(int);
+            set_val(ptr, new_size);
+            return _b;
+        }
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * coalesce the free block with start sentinel b, not on the index,
+         * with the block to its right if that is free, and put it on the index
+         */
+        void settle (char* a, std::size_t n, char* b) {
+            char* _e = b + get_val(b) + sizeof(int);
+            if (_e != &a[n - sizeof(int)]) {
+                char* right = _e + sizeof(int);
+                if (get_val(right) > 0) {
+                    unlink(a, right);
+                    b = coalesce_blocks(_e, right);}}
+            fill(b);
+            link(a, b);}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * return the bytes of payload of the used block of p
+         * throw an invalid_argument exception, if p is not one, which is checked against its own sentinels
+         */
+        static int checked_size (const char* a, std::size_t n, const char* p) {
+            const char* _b = p - sizeof(int);
+            if ((_b < a) || (_b > &a[n - (2 * sizeof(int))]))
+                throw std::invalid_argument("Argument is not in the arena");
+            const int size = -get_val(_b);
+            if ((size <= 0) || (size > &a[n - (2 * sizeof(int))] - _b) || (get_val(_b + size + sizeof(int)) != -size))
+                throw std::invalid_argument("Argument is not an allocated block");
+            return size;}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        Blocks () :
+                index () {}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * make [a, a + n) one free block
+         */
+        void init (char* a, std::size_t n) {
+            assert(n >= sizeof(T) + (2 * sizeof(int)));
+            assert(n - (2 * sizeof(int)) <= INT_MAX);
+            index.init();
+            set_val(a,                   static_cast<int>(n - (2 * sizeof(int))));
+            set_val(a + n - sizeof(int), static_cast<int>(n - (2 * sizeof(int))));
+            fill(a);
+            link(a, a);}
+
+        // -----
+        // valid
+        // -----
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * check if sentinel is valid
+         */
+         static bool valid (const char* a, std::size_t n) {
+             // <your code>
+             assert (n > (2 * sizeof(int)));
+
+             int* ptr = (int*) a;
+             while (ptr < (int*) (&a[n - sizeof(int)])) {
+                 int size = abs(*ptr);
+                 if (!intact((char*) ptr))
+                     return false;
+                 ptr = (int*) ((char*) ptr + size + sizeof(int));
+                 if (abs(*ptr) != size)
+                     return false;
+                 ptr = (int*) ((char*) ptr + sizeof(int));
+             }
+             return true;
+         }
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * return whether [a, a + n) is a single free block again
+         */
+        static bool empty (const char* a, std::size_t n) {
+            return get_val(a) == static_cast<int>(n - (2 * sizeof(int)));}
+
+        // -----
+        // local
+        // -----
+
+        /**
+         * O(1) in space
+         * O(1) in time, O(n) with ALLOCATOR_POISON
+         * check the sentinels of the used block of p, and its canary, and the
+         * sentinels of the blocks on either side of it
+         */
+        static bool local (const char* a, std::size_t n, const char* p) {
+            const char* _b   = p - sizeof(int);
+            const int   size = -get_val(_b);
+            if ((size <= 0) || (size > &a[n - (2 * sizeof(int))] - _b) || (get_val(p + size) != -size) || !intact(_b))
+                return false;
+            if (_b != a) {
+                const int left = std::abs(get_val(_b - sizeof(int)));
+                if ((left > _b - a - static_cast<int>(2 * sizeof(int))) || (get_val(_b - left - (2 * sizeof(int))) != get_val(_b - sizeof(int))))
+                    return false;}
+            const char* _e = p + size + sizeof(int);
+            if (_e != a + n) {
+                const int right = std::abs(get_val(_e));
+                if ((right > a + n - _e - static_cast<int>(2 * sizeof(int))) || (get_val(_e + right + sizeof(int)) != get_val(_e)))
+                    return false;}
+            return true;}
+
+        // ------
+        // survey
+        // ------
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * add the blocks of [a, a + n) to the walk fields of t
+         */
+        static void survey (const char* a, std::size_t n, Statistics& t) {
+            std::size_t top = 0;
+            for (const char* b = a; b != a + n; b += std::abs(get_val(b)) + (2 * sizeof(int))) {
+                const int s = get_val(b);
+                if (s < 0) {
+                    t.in_use += -s;
+                    ++t.used_blocks;
+                    top = b - a - s + (2 * sizeof(int));}
+                else {
+                    t.free += s;
+                    ++t.free_blocks;
+                    t.largest = std::max<std::size_t>(t.largest, s);}}
+            t.top += top;}
+
+        // ----
+        // dump
+        // ----
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * write the blocks of [a, a + n), one offset size used|free line per block,
+         * or a JSON array of [offset, size, used] triples
+         */
+        static void dump (const char* a, std::size_t n, std::ostream& w, bool json) {
+            w << (json ? "[" : "");
+            for (const char* b = a; b != a + n; b += std::abs(get_val(b)) + (2 * sizeof(int))) {
+                const int s = get_val(b);
+                if (json)
+                    w << (b == a ? "" : ", ") << "[" << (b - a) << ", " << std::abs(s) << ", " << (s < 0 ? "true" : "false") << "]";
+                else
+                    w << (b - a) << " " << std::abs(s) << " " << (s < 0 ? "used" : "free") << "\n";}
+            w << (json ? "]" : "");}
+
+        // --------
+        // allocate
+        // --------
+
+        /**
+         * O(1) in space
+         * O(1) in time, amortized, with GoodFit, see P otherwise
+         * after allocation there must be enough space left for a valid block
+         * the smallest allowable block is sizeof(T) + (2 * sizeof(int))
+         * choose a block with P::find
+         * return the payload of a block of at least s bytes, 0 if no block fits
+         */
+        char* allocate (char* a, std::size_t n, std::size_t s) {
+            if (s > INT_MAX - (2 * sizeof(int)) - slack)
+                return 0;
+            const int n_size = static_cast<int>(s + slack);
+            char*     ptr    = index.find(a, n, n_size);
+            if (ptr == 0)
+                return 0;
+            unlink(a, ptr);
+            assert(filled(ptr, n_size));
+
+            const int sentinel_val = get_val(ptr);
+            //if free space left is not enough for another free block
+            //allocate whole block
+            if (sentinel_val < n_size + static_cast<int>(sizeof(T) + (2 * sizeof(int)))) {
+                set_val(ptr, 0 - sentinel_val);
+                set_val(ptr + sentinel_val + sizeof(int), 0 - sentinel_val);
+                mark(ptr);
+                #if ALLOCATOR_CHECK >= 1
+                assert(local(a, n, ptr + sizeof(int)));
+                #endif
+                return ptr + sizeof(int);}
+
+            //if free space left is enough for another free block
+            //form a new block
+            const int free_space = sentinel_val - n_size - (2 * sizeof(int));
+            char*     _e         = ptr + n_size + (2 * sizeof(int));
+
+            //allocate block
+            set_val(ptr, -n_size);
+            set_val(ptr + n_size + sizeof(int), -n_size);
+
+            //set the free space left
+            set_val(_e, free_space);
+            set_val(_e + free_space + sizeof(int), free_space);
+            link(a, _e);
+
+            mark(ptr);
+            #if ALLOCATOR_CHECK >= 1
+            assert(local(a, n, ptr + sizeof(int)));
+            #endif
+            return ptr + sizeof(int);}
+
+        // ----------
+        // deallocate
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * after deallocation adjacent free blocks must be coalesced
+         * throw an invalid_argument exception, if p is invalid, which is checked against its own sentinels
+         * deallocate used blocks and coalesce free blocks
+         * return the bytes of payload p had
+         */
+        int deallocate (char* a, std::size_t n, char* p) {
+            //get start position
+            char* _b = p - sizeof(int);
+            const int size = checked_size(a, n, p);
+            #if ALLOCATOR_CHECK >= 1
+            assert(local(a, n, p));
+            #endif
+            assert(intact(_b));
+            set_val(_b, size);
+
+            //get end position
+            char* _e = p + size;
+            set_val(_e, size);
+
+            //concatenate start to the left
+            if (_b != a) {
+                char* left = _b - sizeof(int);
+                if (get_val(left) > 0) {
+                    unlink(a, left - get_val(left) - sizeof(int));
+                    _b = coalesce_blocks(left, _b);}}
+
+            //concatenate end to the right
+            settle(a, n, _b);
+            return size;
+        }
+
+        // ----------
+        // allocate_n
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(k) in time, amortized
+         * allocate k blocks of s bytes of payload, into p[0] through p[k - 1],
+         * splitting as many as fit off each free block P::find returns before
+         * putting what is left of it back
+         * return the number of blocks allocated, less than k if they did not all fit
+         */
+        std::size_t allocate_n (char* a, std::size_t n, std::size_t s, std::size_t k, char** p) {
+            if (s > INT_MAX - (2 * sizeof(int)) - slack)
+                return 0;
+            const int   n_size = static_cast<int>(s + slack);
+            std::size_t i      = 0;
+            while (i != k) {
+                char* ptr = index.find(a, n, n_size);
+                if (ptr == 0)
+                    break;
+                unlink(a, ptr);
+                int free_space = get_val(ptr);
+                while ((i != k) && (free_space >= n_size)) {
+                    assert(filled(ptr, n_size));
+                    //allocate whole block
+                    if (free_space < n_size + static_cast<int>(sizeof(T) + (2 * sizeof(int)))) {
+                        set_val(ptr, -free_space);
+                        set_val(ptr + free_space + sizeof(int), -free_space);
+                        mark(ptr);
+                        p[i++] = ptr + sizeof(int);
+                        ptr    = 0;
+                        break;}
+                    set_val(ptr, -n_size);
+                    set_val(ptr + n_size + sizeof(int), -n_size);
+                    mark(ptr);
+                    p[i++]      = ptr + sizeof(int);
+                    ptr        += n_size + (2 * sizeof(int));
+                    free_space -= n_size + (2 * sizeof(int));}
+                //set the free space left
+                if (ptr != 0) {
+                    set_val(ptr, free_space);
+                    set_val(ptr + free_space + sizeof(int), free_space);
+                    link(a, ptr);}}
+            return i;}
+
+        // ------------
+        // deallocate_n
+        // ------------
+
+        /**
+         * O(1) in space
+         * O(k log(k)) in time
+         * deallocate p[0] through p[k - 1], sorting them by address, in one sweep
+         * that coalesces each run of adjacent blocks, and its free neighbours,
+         * into a single block before putting it on the index
+         * throw an invalid_argument exception, if any p is invalid or repeated, with none deallocated
+         * return the bytes of payload they had
+         */
+        std::size_t deallocate_n (char* a, std::size_t n, char** p, std::size_t k) {
+            std::sort(p, p + k);
+            for (std::size_t i = 0; i != k; ++i) {
+                checked_size(a, n, p[i]);
+                if ((i != 0) && (p[i] == p[i - 1]))
+                    throw std::invalid_argument("Argument is repeated");
+                assert(intact(p[i] - sizeof(int)));}
+            std::size_t bytes = 0;
+            char*       run   = 0; // the start sentinel of the block being built, not on the index
+            for (std::size_t i = 0; i != k; ++i) {
+                char*     _b   = p[i] - sizeof(int);
+                const int size = -get_val(_b);
+                bytes += size;
+                set_val(_b, size);
+                set_val(p[i] + size, size);
+                if ((run != 0) && (run + get_val(run) + (2 * sizeof(int)) == _b)) {
+                    run = coalesce_blocks(_b - sizeof(int), _b);
+                    continue;}
+                if (run != 0)
+                    settle(a, n, run);
+                run = _b;
+                if (_b != a) {
+                    char* left = _b - sizeof(int);
+                    if (get_val(left) > 0) {
+                        unlink(a, left - get_val(left) - sizeof(int));
+                        run = coalesce_blocks(left, _b);}}}
+            if (run != 0)
+                settle(a, n, run);
+            return bytes;}};
+
+template <typename T, typename P>
+const std::size_t Blocks<T, P>::slack;
+
+template <typename T, typename P>
+const int Blocks<T, P>::canary;
+
+template <typename T, typename P>
+const unsigned char Blocks<T, P>::poison;
 
 // ---------
 // Allocator
 // ---------
 
-template <typename T, std::size_t N>
-class Allocator {
+/**
+ * Ts out of the N bytes of a[N], placed by the policy P, see Blocks
+ */
+template <typename T, std::size_t N, typename P = GoodFit>
+class Allocator : private Counters {
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T                 value_type;
+
+        typedef std::size_t       size_type;
+        typedef std::ptrdiff_t    difference_type;
+
+        typedef       value_type*       pointer;
+        typedef const value_type* const_pointer;
+
+        typedef       value_type&       reference;
+        typedef const value_type& const_reference;
+
+    public:
+        // -----------
+        // operator ==
+        // -----------
+
+        /**
+         * every Allocator owns its own a[N], so only an Allocator can free
+         * what it allocated itself
+         */
+        friend bool operator == (const Allocator& lhs, const Allocator& rhs) {
+            return &lhs == &rhs;}
+
+        // -----------
+        // operator !=
+        // -----------
+
+        friend bool operator != (const Allocator& lhs, const Allocator& rhs) {
+            return !(lhs == rhs);}
+
+    private:
+        template <typename, std::size_t, std::size_t>
+        friend class ConcurrentAllocator;
+
+        // ----
+        // data
+        // ----
+
+        char         a[N];
+        Blocks<T, P> blocks;
+        #if ALLOCATOR_CHECK >= 2
+        std::size_t  calls;    // of allocate, deallocate, construct and destroy, see audit
+        #endif
+
+        /**
+        * return value of an address location
+        */
+        int get_val(const char* ptr) const {
+            return Blocks<T, P>::get_val(ptr);}
+
+        /**
+        * set value of an address location
+        */
+        void set_val(char* ptr, int a) {
+            Blocks<T, P>::set_val(ptr, a);}
+
+        // -----
+        // valid
+        // -----
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * check if sentinel is valid
+         */
+         FRIEND_TEST(TestAllocator4, valid_1);
+         FRIEND_TEST(TestAllocator4, valid_2);
+         FRIEND_TEST(TestAllocator4, valid_3);
+         FRIEND_TEST(TestAllocator5, Allocator_1);
+         FRIEND_TEST(TestAllocator5, Allocator_2);
+         FRIEND_TEST(TestAllocator5, Allocator_3);
+         FRIEND_TEST(TestAllocator8, free_list_1);
+         FRIEND_TEST(TestAllocator8, free_list_2);
+         FRIEND_TEST(TestAllocator8, free_list_3);
+         bool valid () const {
+             return Blocks<T, P>::valid(a, N);}
+
+        /**
+         * O(1) in space
+         * O(1) in time, O(n) every ALLOCATOR_CHECK_EVERY calls with ALLOCATOR_CHECK 2
+         * count a call, and at ALLOCATOR_CHECK 2 return valid() every ALLOCATOR_CHECK_EVERY of them
+         * Blocks makes the checks of ALLOCATOR_CHECK 1 itself
+         */
+        bool audit () {
+            #if ALLOCATOR_CHECK >= 2
+            if (++calls % ALLOCATOR_CHECK_EVERY == 0)
+                return valid();
+            #endif
+            return true;}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * return a reference at the location of the given index
+         * https://code.google.com/p/googletest/wiki/AdvancedGuide#Private_Class_Members
+         */
+        FRIEND_TEST(TestAllocator2, index);
+        FRIEND_TEST(TestAllocator6, allocate_1);
+        FRIEND_TEST(TestAllocator6, allocate_2);
+        FRIEND_TEST(TestAllocator6, allocate_3);
+        FRIEND_TEST(TestAllocator6, allocate_4);
+        FRIEND_TEST(TestAllocator6, allocate_5);
+        FRIEND_TEST(TestAllocator7, deallocate_1);
+        FRIEND_TEST(TestAllocator7, deallocate_2);
+        FRIEND_TEST(TestAllocator7, deallocate_3);
+        FRIEND_TEST(TestAllocator7, deallocate_4);
+        FRIEND_TEST(TestAllocator7, deallocate_5);
+        int& operator [] (int i) {
+            return *reinterpret_cast<int*>(&a[i]);}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * throw a bad_alloc exception, if N is less than sizeof(T) + (2 * sizeof(int))
+         */
+        Allocator () {
+            #if ALLOCATOR_CHECK >= 2
+            calls = 0;
+            #endif
+            // (*this)[0] = 0; // replace
+            // <your code>
+            if (N < sizeof(T) + (2 * sizeof(int)))
+                throw std::bad_alloc();
+            blocks.init(a, N);
+        }
+
+        // Default copy, destructor, and copy assignment
+        // Allocator  (const Allocator&);
+        // ~Allocator ();
+        // Allocator& operator = (const Allocator&);
+
+        // --------
+        // allocate
+        // --------
+
+        /**
+         * O(1) in space
+         * O(1) in time, amortized
+         * choose a block off the free lists, see Blocks
+         * throw a bad_alloc exception, if n is invalid or no block fits
+         */
+        pointer allocate (size_type n) {
+            // <your code>
+            if (n <= 0 || n > (N - 2*sizeof(int))/sizeof(T)) throw std::bad_alloc();
+            char* p = blocks.allocate(a, N, n * sizeof(T));
+            if (p == 0)
+                throw std::bad_alloc();
+            Counters::allocated(n * sizeof(T), -get_val(p - sizeof(int)));
+            assert(audit());
+            return (pointer) p;}
+
+        // ---------
+        // construct
+        // ---------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void construct (pointer p, const_reference v) {
+            new (p) T(v);                               // this is correct and exempt
+            assert(audit());}                           // from the prohibition of new
+
+        // ----------
+        // deallocate
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * after deallocation adjacent free blocks must be coalesced
+         * throw an invalid_argument exception, if p is invalid
+         */
+        void deallocate (pointer p, size_type) {
+            // <your code>
+            if (p == nullptr) throw std::invalid_argument("Argument is null");
+            Counters::freed(blocks.deallocate(a, N, (char*) p));
+            assert(audit());
+        }
+
+        // ----------
+        // allocate_n
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(k) in time, amortized
+         * allocate k blocks of n Ts each, into p[0] through p[k - 1], see Blocks::allocate_n
+         * throw a bad_alloc exception, if n is invalid or the k blocks do not fit, with none of them allocated
+         */
+        void allocate_n (pointer* p, size_type k, size_type n) {
+            if (n <= 0 || n > (N - 2*sizeof(int))/sizeof(T)) throw std::bad_alloc();
+            char** q = reinterpret_cast<char**>(p);
+            const std::size_t i = blocks.allocate_n(a, N, n * sizeof(T), k, q);
+            if (i != k) {
+                blocks.deallocate_n(a, N, q, i);
+                throw std::bad_alloc();}
+            for (std::size_t j = 0; j != k; ++j)
+                Counters::allocated(n * sizeof(T), -get_val(q[j] - sizeof(int)));
+            assert(audit());}
+
+        // ------------
+        // deallocate_n
+        // ------------
+
+        /**
+         * O(1) in space
+         * O(k log(k)) in time
+         * deallocate p[0] through p[k - 1], which are left sorted, see Blocks::deallocate_n
+         * throw an invalid_argument exception, if any of them is invalid, with none deallocated
+         */
+        void deallocate_n (pointer* p, size_type k, size_type) {
+            Counters::freed(blocks.deallocate_n(a, N, reinterpret_cast<char**>(p), k), k);
+            assert(audit());}
+
+        // -------
+        // destroy
+        // -------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void destroy (pointer p) {
+            p->~T();               // this is correct
+            assert(audit());}
+
+        // -----
+        // stats
+        // -----
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * return the counters, see Statistics, and a walk over a[N]
+         */
+        Statistics stats () const {
+            Statistics t = counted();
+            Blocks<T, P>::survey(a, N, t);
+            return t;}
+
+        // ----
+        // dump
+        // ----
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * write stats on the first line and then a line per block, see Blocks::dump,
+         * or both as one JSON object
+         */
+        void dump (std::ostream& w, bool json = false) const {
+            w << (json ? "{" : "");
+            stats().print(w, json);
+            w << (json ? ", \"blocks\": " : "\n");
+            Blocks<T, P>::dump(a, N, w, json);
+            w << (json ? "}\n" : "");}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * return a const reference at the location of the given index
+         */
+        const int& operator [] (int i) const {
+            return *reinterpret_cast<const int*>(&a[i]);}};
+
+// -------------
+// PoolAllocator
+// -------------
+
+/**
+ * an Allocator for single objects only, allocate(1)
+ * the objects are packed in a[N] at a stride of sizeof(T), with no sentinels,
+ * and a freed slot holds the index of the next free slot, so allocate and
+ * deallocate are O(1) and the constructor does not touch a[N] at all:
+ * slots past fresh have never been used and are handed out in order
+ */
+template <typename T, std::size_t N>
+class PoolAllocator {
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T                 value_type;
+
+        typedef std::size_t       size_type;
+        typedef std::ptrdiff_t    difference_type;
+
+        typedef       value_type*       pointer;
+        typedef const value_type* const_pointer;
+
+        typedef       value_type&       reference;
+        typedef const value_type& const_reference;
+
+    private:
+        // ----
+        // data
+        // ----
+
+        typedef std::uint32_t link; // a slot index + 1, 0 for none
+
+        static const std::size_t stride = (sizeof(T) > sizeof(link)) ? sizeof(T) : sizeof(link);
+        static const std::size_t slots  = N / stride;
+        static const std::size_t align  = (alignof(T) > alignof(link)) ? alignof(T) : alignof(link);
+
+        static_assert(slots < 0xFFFFFFFFU, "slots are numbered in 32 bits");
+
+        alignas(align) char a[N];
+        link                free;  // the first free slot
+        std::size_t         fresh; // the first slot never used
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        link& next (std::size_t i) {
+            return *reinterpret_cast<link*>(&a[i * stride]);}
+
+        // -----
+        // valid
+        // -----
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * check that the free list stays inside the used slots and ends
+         */
+        FRIEND_TEST(TestAllocator12, pool_2);
+        bool valid () {
+            std::size_t k = 0;
+            for (link i = free; i != 0; i = next(i - 1)) {
+                if ((i > fresh) || (++k > fresh))
+                    return false;}
+            return true;}
+
+    public:
+        // -----------
+        // operator ==
+        // -----------
+
+        friend bool operator == (const PoolAllocator& lhs, const PoolAllocator& rhs) {
+            return &lhs == &rhs;}
+
+        // -----------
+        // operator !=
+        // -----------
+
+        friend bool operator != (const PoolAllocator& lhs, const PoolAllocator& rhs) {
+            return !(lhs == rhs);}
+
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * throw a bad_alloc exception, if N is less than sizeof(T)
+         */
+        PoolAllocator () :
+                free  (0),
+                fresh (0) {
+            if (slots == 0)
+                throw std::bad_alloc();}
+
+        PoolAllocator             (const PoolAllocator&) = delete;
+        PoolAllocator& operator = (const PoolAllocator&) = delete;
+
+        // --------
+        // allocate
+        // --------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * throw a bad_alloc exception, if n is not 1 or every slot is in use
+         */
+        pointer allocate (size_type n) {
+            if (n != 1)
+                throw std::bad_alloc();
+            std::size_t i;
+            if (free != 0) {
+                i    = free - 1;
+                free = next(i);}
+            else if (fresh != slots)
+                i = fresh++;
+            else
+                throw std::bad_alloc();
+            return reinterpret_cast<pointer>(&a[i * stride]);}
+
+        // ---------
+        // construct
+        // ---------
+
+        void construct (pointer p, const_reference v) {
+            new (p) T(v);}
+
+        // ----------
+        // deallocate
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * throw an invalid_argument exception, if p is not a slot of this pool
+         */
+        void deallocate (pointer p, size_type) {
+            if (p == nullptr) throw std::invalid_argument("Argument is null");
+            const char* q = reinterpret_cast<const char*>(p);
+            if ((q < a) || (q >= &a[fresh * stride]) || ((q - a) % stride != 0))
+                throw std::invalid_argument("Argument is not a slot of the pool");
+            const std::size_t i = (q - a) / stride;
+            next(i) = free;
+            free    = static_cast<link>(i + 1);}
+
+        // -------
+        // destroy
+        // -------
+
+        void destroy (pointer p) {
+            p->~T();}};
+
+// -------------
+// HeapAllocator
+// -------------
+
+/**
+ * an Allocator whose capacity is chosen at run time instead of by N
+ * memory comes from mmap in chunks, each one laid out like the a[N] of an
+ * Allocator with free lists of its own
+ * when no chunk has room another is mapped, as large as the first or as the
+ * request, whichever is larger, and a chunk other than the first is unmapped
+ * as soon as its last block is freed
+ * with huge set, chunks are 2 MiB huge pages if the system has them reserved
+ * and transparent huge pages otherwise
+ * when sizeof(T) is a multiple of 8 every block is 8 byte aligned
+ */
+template <typename T, typename P = GoodFit>
+class HeapAllocator : private Counters {
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T                 value_type;
+
+        typedef std::size_t       size_type;
+        typedef std::ptrdiff_t    difference_type;
+
+        typedef       value_type*       pointer;
+        typedef const value_type* const_pointer;
+
+        typedef       value_type&       reference;
+        typedef const value_type& const_reference;
+
+    private:
+        // ----
+        // data
+        // ----
+
+        // the blocks start sizeof(int) past the header, which is a multiple
+        // of align, so payloads whose sizes are multiples of align stay aligned
+
+        static const std::size_t align = 8;
+
+        struct Chunk {
+            Chunk*      next;
+            std::size_t length; // bytes mapped, this header included
+            std::size_t size;   // bytes of blocks after the header
+            Blocks<T, P> blocks;
+
+            char* begin () {
+                return reinterpret_cast<char*>(this + 1) + sizeof(int);}};
+
+        static_assert(sizeof(Chunk) % align == 0, "blocks would not be aligned");
+
+        static const std::size_t huge_page = 2 * 1024 * 1024;
+
+        Chunk*      first;
+        std::size_t capacity;
+        bool        huge;
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * map a chunk with at least s bytes of blocks
+         * throw a bad_alloc exception, if the system has no memory or s is too large for int sentinels
+         */
+        Chunk* map (std::size_t s) {
+            if (s > INT_MAX - sizeof(Chunk) - align)
+                throw std::bad_alloc();
+            const std::size_t page   = huge ? huge_page : static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+            const std::size_t length = (sizeof(Chunk) + align + s + page - 1) / page * page;
+            void*             m      = MAP_FAILED;
+            #ifdef MAP_HUGETLB
+            if (huge)
+                m = mmap(0, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            #endif
+            if (m == MAP_FAILED) {
+                m = mmap(0, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (m == MAP_FAILED)
+                    throw std::bad_alloc();
+                #ifdef MADV_HUGEPAGE
+                if (huge)
+                    madvise(m, length, MADV_HUGEPAGE);
+                #endif
+            }
+            Chunk* c  = new (m) Chunk;
+            c->next   = 0;
+            c->length = length;
+            c->size   = std::min<std::size_t>(length - sizeof(Chunk) - align, INT_MAX / align * align);
+            c->blocks.init(c->begin(), c->size);
+            return c;}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        static void unmap (Chunk* c) {
+            const std::size_t length = c->length;
+            c->~Chunk();
+            munmap(c, length);}
+
+        // -----
+        // valid
+        // -----
+
+        FRIEND_TEST(TestAllocator10, heap_1);
+        FRIEND_TEST(TestAllocator10, heap_2);
+        FRIEND_TEST(TestAllocator10, heap_3);
+        FRIEND_TEST(TestAllocator10, heap_4);
+        FRIEND_TEST(TestAllocator11, arena_2);
+        bool valid () {
+            for (Chunk* c = first; c != 0; c = c->next)
+                if (!Blocks<T, P>::valid(c->begin(), c->size))
+                    return false;
+            return true;}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * @param capacity the bytes of blocks in the first chunk, which is never unmapped
+         * @param huge     whether to back chunks with huge pages
+         * throw a bad_alloc exception, if capacity is less than sizeof(T) + (2 * sizeof(int))
+         */
+        explicit HeapAllocator (std::size_t capacity = 1 << 20, bool huge = false) :
+                first    (0),
+                capacity (capacity),
+                huge     (huge) {
+            if (capacity < sizeof(T) + (2 * sizeof(int)))
+                throw std::bad_alloc();
+            first = map(capacity);}
+
+        HeapAllocator             (const HeapAllocator&) = delete;
+        HeapAllocator& operator = (const HeapAllocator&) = delete;
+
+        ~HeapAllocator () {
+            while (first != 0) {
+                Chunk* c = first;
+                first = first->next;
+                unmap(c);}}
+
+        // --------
+        // allocate
+        // --------
+
+        /**
+         * O(1) in space
+         * O(1) in time per chunk, amortized
+         * throw a bad_alloc exception, if n is invalid or the system has no memory
+         */
+        pointer allocate (size_type n) {
+            if ((n == 0) || (n > (INT_MAX - sizeof(Chunk) - align - (2 * sizeof(int)) - Blocks<T, P>::slack) / sizeof(T)))
+                throw std::bad_alloc();
+            const std::size_t s = n * sizeof(T);
+            char* p = 0;
+            for (Chunk* c = first; (p == 0) && (c != 0); c = c->next)
+                p = c->blocks.allocate(c->begin(), c->size, s);
+            if (p == 0) {
+                Chunk* c = map(std::max(capacity, s + Blocks<T, P>::slack + (2 * sizeof(int))));
+                c->next     = first->next;
+                first->next = c;
+                p = c->blocks.allocate(c->begin(), c->size, s);
+                assert(p != 0);}
+            Counters::allocated(s, -Blocks<T, P>::get_val(p - sizeof(int)));
+            return (pointer) p;}
+
+        // ---------
+        // construct
+        // ---------
+
+        void construct (pointer p, const_reference v) {
+            new (p) T(v);}
+
+        // ----------
+        // deallocate
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(1) in time per chunk
+         * throw an invalid_argument exception, if p is invalid
+         */
+        void deallocate (pointer p, size_type) {
+            if (p == nullptr) throw std::invalid_argument("Argument is null");
+            char* q = (char*) p;
+            for (Chunk* b = 0, *c = first; c != 0; b = c, c = c->next)
+                if ((q > c->begin()) && (q < c->begin() + c->size)) {
+                    Counters::freed(c->blocks.deallocate(c->begin(), c->size, q));
+                    if ((b != 0) && Blocks<T, P>::empty(c->begin(), c->size)) {
+                        b->next = c->next;
+                        unmap(c);}
+                    return;}
+            throw std::invalid_argument("Argument is not in the heap");}
+
+        // -------
+        // destroy
+        // -------
+
+        void destroy (pointer p) {
+            p->~T();}
+
+        // ------
+        // chunks
+        // ------
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * return the number of chunks mapped
+         */
+        size_type chunks () const {
+            size_type k = 0;
+            for (const Chunk* c = first; c != 0; c = c->next)
+                ++k;
+            return k;}
+
+        // -----
+        // stats
+        // -----
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * return the counters, see Statistics, and a walk over every chunk
+         */
+        Statistics stats () const {
+            Statistics t = counted();
+            for (Chunk* c = first; c != 0; c = c->next)
+                Blocks<T, P>::survey(c->begin(), c->size, t);
+            return t;}
+
+        // ----
+        // dump
+        // ----
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * write stats on the first line and then the blocks of each chunk after
+         * a chunk line, see Blocks::dump, or all of it as one JSON object
+         */
+        void dump (std::ostream& w, bool json = false) const {
+            w << (json ? "{" : "");
+            stats().print(w, json);
+            w << (json ? ", \"chunks\": [" : "\n");
+            for (Chunk* c = first; c != 0; c = c->next) {
+                if (!json)
+                    w << "chunk " << c->size << "\n";
+                else if (c != first)
+                    w << ", ";
+                Blocks<T, P>::dump(c->begin(), c->size, w, json);}
+            w << (json ? "]}\n" : "");}};
+
+// --------------
+// ArenaAllocator
+// --------------
+
+/**
+ * a standard allocator for T that draws on an arena shared by every copy and
+ * every rebinding of it, so a std::list or a std::map keeps its nodes together
+ * the arena, a HeapAllocator<std::uint64_t> by default, hands out whole words,
+ * which keeps every block word aligned, and must outlive every container on it
+ * two ArenaAllocators are equal if they share an arena, and containers take
+ * the arena along on copy and move assignment and on swap
+ */
+template <typename T, typename A = HeapAllocator<std::uint64_t> >
+class ArenaAllocator {
     public:
         // --------
         // typedefs
@@ -32,90 +1617,316 @@ class Allocator {
         typedef       value_type&       reference;
         typedef const value_type& const_reference;
 
+        typedef A                 arena_type;
+
+        typedef std::true_type    propagate_on_container_copy_assignment;
+        typedef std::true_type    propagate_on_container_move_assignment;
+        typedef std::true_type    propagate_on_container_swap;
+        typedef std::false_type   is_always_equal;
+
+        template <typename U>
+        struct rebind {
+            typedef ArenaAllocator<U, A> other;};
+
+    private:
+        typedef typename A::value_type unit;
+
+        // ----
+        // data
+        // ----
+
+        A* shared;
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * return the number of units of the arena that n Ts take
+         */
+        static std::size_t units (size_type n) {
+            if (n > ~std::size_t(0) / sizeof(T) - sizeof(unit))
+                throw std::bad_alloc();
+            return (n * sizeof(T) + sizeof(unit) - 1) / sizeof(unit);}
+
     public:
         // -----------
         // operator ==
         // -----------
 
-        friend bool operator == (const Allocator&, const Allocator&) {
-            return true;}                                              // this is correct
+        template <typename U>
+        friend bool operator == (const ArenaAllocator& lhs, const ArenaAllocator<U, A>& rhs) {
+            return &lhs.arena() == &rhs.arena();}
 
         // -----------
         // operator !=
         // -----------
 
-        friend bool operator != (const Allocator& lhs, const Allocator& rhs) {
+        template <typename U>
+        friend bool operator != (const ArenaAllocator& lhs, const ArenaAllocator<U, A>& rhs) {
             return !(lhs == rhs);}
 
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * @param arena the arena to draw on, which must outlive this and every copy of it
+         */
+        explicit ArenaAllocator (A& arena) :
+                shared (&arena) {}
+
+        template <typename U>
+        ArenaAllocator (const ArenaAllocator<U, A>& that) :
+                shared (&that.arena()) {}
+
+        // -----
+        // arena
+        // -----
+
+        A& arena () const {
+            return *shared;}
+
+        // --------
+        // allocate
+        // --------
+
+        /**
+         * throw a bad_alloc exception, if the arena has no room
+         */
+        pointer allocate (size_type n) {
+            return reinterpret_cast<pointer>(shared->allocate(units(n)));}
+
+        // ----------
+        // deallocate
+        // ----------
+
+        void deallocate (pointer p, size_type n) {
+            shared->deallocate(reinterpret_cast<unit*>(p), units(n));}};
+
+// -------------------
+// ConcurrentAllocator
+// -------------------
+
+/**
+ * an Allocator<T, N> that up to S threads share without serializing on it
+ * each thread claims a slot with a cache of freed blocks for every count
+ * from 1 to classes, and only locks the shared arena to refill or drain a
+ * cache, half of it at a time
+ * a block freed by a thread other than the one that allocated it is pushed,
+ * lock free, onto its owner's remote list, which the owner takes whole the
+ * next time one of its caches runs dry
+ * threads beyond the first S, and counts above classes, go straight to the
+ * arena under the lock
+ */
+template <typename T, std::size_t N, std::size_t S>
+class ConcurrentAllocator {
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T                 value_type;
+
+        typedef std::size_t       size_type;
+        typedef std::ptrdiff_t    difference_type;
+
+        typedef       value_type*       pointer;
+        typedef const value_type* const_pointer;
+
+        typedef       value_type&       reference;
+        typedef const value_type& const_reference;
+
     private:
         // ----
         // data
         // ----
 
-        char a[N];
+        static const int classes  = 8;  // cached counts, 1 through classes
+        static const int capacity = 16; // blocks per cache
+
+        static const std::size_t stride = sizeof(T) + (2 * sizeof(int)); // the smallest block
+        static_assert(S < 256, "slots are numbered in a byte");
+
+        struct Slot {
+            std::atomic<std::size_t> owner;                      // thread_index() + 1 of the thread using it, 0 for none
+            std::atomic<int>         remote;                     // payload offset of the first block freed by another thread, 0 for none
+            int                      count[classes];             // touched by the owner only
+            pointer                  blocks[classes][capacity];
+
+            Slot () :
+                    owner  (0),
+                    remote (0),
+                    count  () {}};
+
+        std::mutex              lock;  // guards arena
+        Allocator<T, N>         arena;
+        Slot                    slots[S];
+        std::atomic<unsigned char> owners[N / stride + 1]; // slot + 1 of the thread that allocated the block with each header, 0 for none
 
         /**
-        * return value of an address location
-        */
-        int get_val(char* ptr) {
-            return *reinterpret_cast<const int*> (ptr);}
+         * O(1) in space
+         * O(1) in time
+         * return a number unique to the calling thread
+         */
+        static std::size_t thread_index () {
+            static std::atomic<std::size_t> next(0);
+            static thread_local std::size_t k = next++;
+            return k;}
 
         /**
-        * set value of an address location
-        */
-        void set_val(char* ptr, int a) {
-            int* set_ptr = (int*) (ptr);
-            *set_ptr = a;}
+         * O(1) in space
+         * O(1) in time
+         * the allocators alive, so that a thread that exits only gives its
+         * slots back to those, guarded by the mutex
+         */
+        static std::mutex& registry () {
+            static std::mutex m;
+            return m;}
 
-        // -----
-        // valid
-        // -----
+        static std::set<ConcurrentAllocator*>& alive () {
+            static std::set<ConcurrentAllocator*> a;
+            return a;}
+
+        /**
+         * the allocators a thread holds a slot in, which gives the slots back
+         * when the thread exits, as flush would
+         */
+        struct Holder {
+            std::size_t                       k;
+            std::vector<ConcurrentAllocator*> held;
+
+            Holder () :
+                    k (thread_index()) {}
+
+            ~Holder () {
+                std::lock_guard<std::mutex> g(registry());
+                for (std::size_t i = 0; i != held.size(); ++i)
+                    if (alive().count(held[i]) != 0)
+                        held[i]->leave(k);}};
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * return the slot of the calling thread, claiming it on first use, 0 if another thread holds it
+         */
+        Slot* slot () {
+            const std::size_t k = thread_index();
+            Slot&             t = slots[k % S];
+            std::size_t       o = t.owner.load(std::memory_order_relaxed);
+            if (o == k + 1)
+                return &t;
+            if ((o != 0) || !t.owner.compare_exchange_strong(o, k + 1, std::memory_order_acquire))
+                return 0;
+            static thread_local Holder h;
+            if (std::find(h.held.begin(), h.held.end(), this) == h.held.end())
+                h.held.push_back(this);
+            return &t;}
 
         /**
          * O(1) in space
          * O(n) in time
-         * check if sentinel is valid
+         * give the cached blocks of the slot of thread k back to the arena and
+         * free the slot for another thread, if thread k holds it
          */
-         FRIEND_TEST(TestAllocator4, valid_1);
-         FRIEND_TEST(TestAllocator4, valid_2);
-         FRIEND_TEST(TestAllocator4, valid_3);
-         FRIEND_TEST(TestAllocator5, Allocator_1);
-         FRIEND_TEST(TestAllocator5, Allocator_2);
-         FRIEND_TEST(TestAllocator5, Allocator_3);
-         bool valid () const {
-             // <your code>
-             assert (N > (2 * sizeof(int)));
+        void leave (std::size_t k) {
+            Slot& t = slots[k % S];
+            if (t.owner.load(std::memory_order_relaxed) != k + 1)
+                return;
+            collect(t);
+            for (int c = 0; c != classes; ++c)
+                drain(t, c, 0);
+            t.owner.store(0);
+            reclaim(t);}
 
-             int* ptr = (int*) a;
-             while (ptr < (int*) (&a[N - sizeof(int)])) {
-                 int size = abs(*ptr);
-                 ptr = (int*) ((char*) ptr + size + sizeof(int));
-                 if (abs(*ptr) != size)
-                     return false;
-                 ptr = (int*) ((char*) ptr + sizeof(int));
-             }
-             return true;
-         }
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        char* header (pointer p) {
+            return reinterpret_cast<char*>(p) - sizeof(int);}
 
         /**
          * O(1) in space
          * O(1) in time
-         * return a reference at the location of the given index
-         * https://code.google.com/p/googletest/wiki/AdvancedGuide#Private_Class_Members
+         * return the owner entry of the block of p, distinct for every block
+         * since block headers are at least stride apart
          */
-        FRIEND_TEST(TestAllocator2, index);
-        FRIEND_TEST(TestAllocator6, allocate_1);
-        FRIEND_TEST(TestAllocator6, allocate_2);
-        FRIEND_TEST(TestAllocator6, allocate_3);
-        FRIEND_TEST(TestAllocator6, allocate_4);
-        FRIEND_TEST(TestAllocator6, allocate_5);
-        FRIEND_TEST(TestAllocator7, deallocate_1);
-        FRIEND_TEST(TestAllocator7, deallocate_2);
-        FRIEND_TEST(TestAllocator7, deallocate_3);
-        FRIEND_TEST(TestAllocator7, deallocate_4);
-        FRIEND_TEST(TestAllocator7, deallocate_5);
-        int& operator [] (int i) {
-            return *reinterpret_cast<int*>(&a[i]);}
+        std::atomic<unsigned char>& owner (pointer p) {
+            return owners[(header(p) - arena.a) / stride];}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * return the number of Ts the block of p holds, its canary aside
+         */
+        int capacity_of (pointer p) {
+            return static_cast<int>((-arena.get_val(header(p)) - Blocks<T>::slack) / sizeof(T));}
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * give a cache's blocks back to the arena, all but keep of them
+         */
+        void drain (Slot& t, int c, int keep) {
+            std::lock_guard<std::mutex> g(lock);
+            while (t.count[c] > keep) {
+                const pointer p = t.blocks[c][--t.count[c]];
+                owner(p).store(0, std::memory_order_relaxed);
+                arena.deallocate(p, c + 1);}}
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * move every block other threads have freed into the caches of t
+         */
+        void collect (Slot& t) {
+            int o = t.remote.exchange(0, std::memory_order_acquire);
+            while (o != 0) {
+                const pointer p = reinterpret_cast<pointer>(arena.a + o);
+                o = arena.get_val(arena.a + o);
+                release(t, p);}}
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * give every block other threads have freed to a slot nobody holds back to the arena
+         */
+        void reclaim (Slot& t) {
+            int o = t.remote.exchange(0);
+            if (o == 0)
+                return;
+            std::lock_guard<std::mutex> g(lock);
+            while (o != 0) {
+                const pointer p = reinterpret_cast<pointer>(arena.a + o);
+                o = arena.get_val(arena.a + o);
+                owner(p).store(0, std::memory_order_relaxed);
+                arena.deallocate(p, 1);}}
+
+        /**
+         * O(1) in space
+         * O(1) in time, amortized
+         * put the block of p in a cache of t, owned by t
+         */
+        void release (Slot& t, pointer p) {
+            const int c = capacity_of(p);
+            if (c > classes) {
+                std::lock_guard<std::mutex> g(lock);
+                owner(p).store(0, std::memory_order_relaxed);
+                arena.deallocate(p, c);
+                return;}
+            if (t.count[c - 1] == capacity)
+                drain(t, c - 1, capacity / 2);
+            t.blocks[c - 1][t.count[c - 1]++] = p;}
+
+        // -----
+        // valid
+        // -----
+
+        FRIEND_TEST(TestAllocator9, concurrent_1);
+        FRIEND_TEST(TestAllocator9, concurrent_2);
+        FRIEND_TEST(TestAllocator9, concurrent_3);
+        bool valid () {
+            std::lock_guard<std::mutex> g(lock);
+            return arena.valid();}
 
     public:
         // ------------
@@ -123,26 +1934,19 @@ class Allocator {
         // ------------
 
         /**
-         * O(1) in space
-         * O(1) in time
          * throw a bad_alloc exception, if N is less than sizeof(T) + (2 * sizeof(int))
          */
-        Allocator () {
-            // (*this)[0] = 0; // replace
-            // <your code>
-            if (N < sizeof(T) + (2 * sizeof(int)))
-                throw std::bad_alloc();
+        ConcurrentAllocator () :
+                owners () {
+            std::lock_guard<std::mutex> g(registry());
+            alive().insert(this);}
 
-            int* ptr = (int*) a;
-            *ptr = N - (2 * sizeof(int));
-            ptr = (int*) (&a[N - sizeof(int)]);
-            *ptr = N - (2 * sizeof(int));
-        }
+        ConcurrentAllocator             (const ConcurrentAllocator&) = delete;
+        ConcurrentAllocator& operator = (const ConcurrentAllocator&) = delete;
 
-        // Default copy, destructor, and copy assignment
-        // Allocator  (const Allocator&);
-        // ~Allocator ();
-        // Allocator& operator = (const Allocator&);
+        ~ConcurrentAllocator () {
+            std::lock_guard<std::mutex> g(registry());
+            alive().erase(this);}
 
         // --------
         // allocate
@@ -150,95 +1954,36 @@ class Allocator {
 
         /**
          * O(1) in space
-         * O(n) in time
-         * after allocation there must be enough space left for a valid block
-         * the smallest allowable block is sizeof(T) + (2 * sizeof(int))
-         * choose the first block that fits
-         * throw a bad_alloc exception, if n is invalid
+         * O(1) in time, amortized, for n up to classes
+         * throw a bad_alloc exception, if n is invalid or no block fits
          */
         pointer allocate (size_type n) {
-            // <your code>
-            if (n <= 0 || n > (N - 2*sizeof(int))/sizeof(T)) throw std::bad_alloc();
-            // if (n > (N - 2*sizeof(int))/sizeof(T)) throw std::bad_alloc();
-
-            int n_size = n * sizeof(T);
-            char* ptr = a;
-
-            //search for first fit block
-            while (ptr < &a[N - sizeof(int)]) {
-                int sentinel_val = get_val(ptr);
-                //chech if there is a fit block
-                if (sentinel_val >= n_size + (2 * sizeof(int))) {
-                    //if free space left is not enough for another free block
-                    //allocate whole block
-                    if (sentinel_val < n_size + sizeof(T) + (2 * sizeof(int))) {
-                        int size = get_val(ptr);
-                        set_val(ptr, 0 - size);
-                        set_val(ptr + size + sizeof(int), 0 - size);
-                        assert(valid());
-                        return ((pointer) (ptr + sizeof(int)));
-
-                    //if free space left is enough for another free block
-                    //form a new block
-                    } else {
-                        int free_space = sentinel_val - n_size - (2 * sizeof(int));
-                        char* _e = ptr + sentinel_val + sizeof(int);
-
-                        //allocate block
-                        set_val(ptr, -n_size);
-                        ptr = ptr + n_size + sizeof(int);
-                        set_val(ptr, -n_size);
-
-                        //set the free space left
-                        set_val(_e, free_space);
-                        _e = _e - free_space - sizeof(int);
-                        set_val(_e, free_space);
-
-                        // assert(valid());
-                        return (pointer) (ptr - n_size);
-                    }
-
-
-                //block is not fit, move to the next one
-                } else
-                    ptr += (abs)(*ptr) + (2 * sizeof(int));}
-
-            assert(valid());
-            return 0;
-        }             // replace!
+            Slot* t = slot();
+            if ((t == 0) || (n == 0) || (n > classes)) {
+                std::lock_guard<std::mutex> g(lock);
+                return arena.allocate(n);}
+            const int c = static_cast<int>(n) - 1;
+            if (t->count[c] == 0)
+                collect(*t);
+            if (t->count[c] == 0) {
+                std::lock_guard<std::mutex> g(lock);
+                try {
+                    while (t->count[c] != capacity / 2) {
+                        const pointer p = arena.allocate(n);
+                        t->blocks[c][t->count[c]++] = p;}}
+                catch (std::bad_alloc&) {
+                    if (t->count[c] == 0)
+                        throw;}}
+            const pointer p = t->blocks[c][--t->count[c]];
+            owner(p).store(static_cast<unsigned char>(t - slots + 1), std::memory_order_relaxed);
+            return p;}
 
         // ---------
         // construct
         // ---------
 
-        /**
-         * O(1) in space
-         * O(1) in time
-         */
         void construct (pointer p, const_reference v) {
-            new (p) T(v);                               // this is correct and exempt
-            assert(valid());}                           // from the prohibition of new
-
-            // ---------
-            // coalesce
-            // ---------
-
-            /**
-            * concatenate 2 free blocks together
-            */
-        void coalesce_blocks(char* left, char* right) {
-            assert(get_val(left) > 0);
-            assert(get_val(right) > 0);
-
-            char* ptr = left;
-            int new_size = get_val(left) + get_val(right) + 2 * sizeof(int);
-
-            ptr = ptr - get_val(left) - sizeof(int);
-            set_val(ptr, new_size);
-
-            ptr = ptr + get_val(right) + sizeof(int);
-            set_val(ptr, new_size);
-        }
+            new (p) T(v);}
 
         // ----------
         // deallocate
@@ -246,55 +1991,50 @@ class Allocator {
 
         /**
          * O(1) in space
-         * O(1) in time
-         * after deallocation adjacent free blocks must be coalesced
-         * throw an invalid_argument exception, if p is invalid
-         * deallocate used blocks and coalesce free blocks
+         * O(1) in time, amortized
+         * throw an invalid_argument exception, if p is null
          */
-        void deallocate (pointer p, size_type) {
-            // <your code>
+        void deallocate (pointer p, size_type n) {
             if (p == nullptr) throw std::invalid_argument("Argument is null");
-            //get start position
-            char* _b = (char*)(p) - sizeof(int);
-            set_val(_b, 0 - get_val(_b));
-
-            //get end position
-            char* _e = (char*)(p) + get_val(_b);
-            set_val(_e, 0 - get_val(_e));
-
-            //concatenate start to the left
-            if (_b > &a[4]) {
-                char* left = _b - sizeof(int);
-                if (get_val(left) > 0)
-                    coalesce_blocks(left, _b);}
-
-            //concatenate end to the right
-            if (_e < &a[N - 3]) {
-                char* right = _e + sizeof(int);
-                if (get_val(right) > 0)
-                    coalesce_blocks(_e, right);}
-            // assert(valid());
-        }
+            Slot*       t = slot();
+            const int   o = owner(p).load(std::memory_order_relaxed);
+            if ((o != 0) && ((t == 0) || (o != t - slots + 1)) && (slots[o - 1].owner.load() != 0) && (capacity_of(p) * sizeof(T) >= sizeof(int))) {
+                // hand the block back to the thread that allocated it
+                std::atomic<int>& r = slots[o - 1].remote;
+                const int         b = static_cast<int>(reinterpret_cast<char*>(p) - arena.a);
+                int               h = r.load(std::memory_order_relaxed);
+                do
+                    arena.set_val(arena.a + b, h);
+                while (!r.compare_exchange_weak(h, b, std::memory_order_seq_cst, std::memory_order_relaxed));
+                // the thread may have left since, after its last look at the list
+                if (slots[o - 1].owner.load() == 0)
+                    reclaim(slots[o - 1]);
+                return;}
+            if (t == 0) {
+                std::lock_guard<std::mutex> g(lock);
+                owner(p).store(0, std::memory_order_relaxed);
+                arena.deallocate(p, n);
+                return;}
+            release(*t, p);}
 
         // -------
         // destroy
         // -------
 
-        /**
-         * O(1) in space
-         * O(1) in time
-         */
         void destroy (pointer p) {
-            p->~T();               // this is correct
-            assert(valid());}
+            p->~T();}
+
+        // -----
+        // flush
+        // -----
 
         /**
          * O(1) in space
-         * O(1) in time
-         * return a const reference at the location of the given index
+         * O(n) in time
+         * give the calling thread's cached blocks back to the arena and free its slot
+         * for another thread, which a thread's exit also does
          */
-        const int& operator [] (int i) const {
-            return *reinterpret_cast<const int*>(&a[i]);}};
-
+        void flush () {
+            leave(thread_index());}};
 
 #endif // Allocator_h
@@ -0,0 +1,170 @@
+// -------------------------------------
+// projects/allocator/BenchAllocator.c++
+// Copyright (C) 2015
+// Glenn P. Downing
+// -------------------------------------
+
+// https://github.com/google/benchmark
+
+// --------
+// includes
+// --------
+
+#include <cstddef>  // size_t
+#include <fstream>  // ifstream
+#include <iostream> // cerr, ios_base
+#include <memory>   // unique_ptr
+#include <random>   // mt19937, discrete_distribution, uniform_int_distribution
+#include <string>   // string
+#include <vector>   // vector
+
+#include "benchmark/benchmark.h"
+
+#include "gtest/gtest_prod.h"
+
+#define ALLOCATOR_STATS
+#include "Allocator.h"
+#include "Trace.h"
+
+using namespace std;
+
+// the bytes of every arena, and of those for recorded traces, as in ReplayAllocator
+#define ARENA    (1 << 20)
+#define RECORDED (64 << 20)
+
+// ------
+// traces
+// ------
+
+/**
+ * the pointer recorded for slot k, which stands in for a block that is
+ * allocated into the slot and freed out of it
+ */
+static const void* slot (int k) {
+    return reinterpret_cast<const void*>(static_cast<size_t>(k + 1));}
+
+/**
+ * ops on slots picked at random, a free if the slot is taken and an
+ * allocate otherwise, sizes mostly small with a tail of large ones
+ */
+static void mixed (Trace& t) {
+    mt19937                      g(371);
+    uniform_int_distribution<>   pick(0, 2047);
+    discrete_distribution<>      kind({70, 25, 5});
+    uniform_int_distribution<>   small(1, 8), medium(9, 64), large(65, 512);
+    vector<bool>                 taken(2048);
+    for (int i = 0; i != 200000; ++i) {
+        const int k = pick(g);
+        if (taken[k])
+            t.deallocate(slot(k));
+        else {
+            const int c = kind(g);
+            t.allocate(slot(k), sizeof(double) * (c == 0 ? small(g) : c == 1 ? medium(g) : large(g)));}
+        taken[k] = !taken[k];}}
+
+/**
+ * rounds of many small blocks, every other one freed, then larger blocks
+ * that the holes left behind cannot take, then everything freed
+ */
+static void phased (Trace& t) {
+    for (int r = 0; r != 20; ++r) {
+        for (int k = 0; k != 4000; ++k)
+            t.allocate(slot(k), sizeof(double) * (1 + (k + r) % 4));
+        for (int k = 0; k < 4000; k += 2)
+            t.deallocate(slot(k));
+        for (int k = 4000; k != 4200; ++k)
+            t.allocate(slot(k), sizeof(double) * (40 + k % 24));
+        for (int k = 1; k < 4000; k += 2)
+            t.deallocate(slot(k));
+        for (int k = 4000; k != 4200; ++k)
+            t.deallocate(slot(k));}}
+
+static const Trace& trace (int i) {
+    static Trace t[2];
+    static const bool built = (mixed(t[0]), phased(t[1]), true);
+    (void) built;
+    return t[i];}
+
+// ------------
+// BM_placement
+// ------------
+
+// t, once per iteration, into a fresh arena of N bytes, see replay_pass
+template <typename P, size_t N>
+static void placement (benchmark::State& state, const Trace& t) {
+    typedef Allocator<char, N, P> allocator_type;
+    size_t failed = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        unique_ptr<allocator_type> x(new allocator_type);
+        Arena<allocator_type>      s(*x);
+        state.ResumeTiming();
+        failed = replay_pass(t, s, [] (size_t) {});
+        benchmark::ClobberMemory();}
+    state.SetItemsProcessed(state.iterations() * t.ops().size());
+
+    // once more, untimed, for the layout
+    unique_ptr<allocator_type> x(new allocator_type);
+    Arena<allocator_type>      s(*x);
+    const size_t sample = 1000;
+    double       f      = 0;
+    size_t       k      = 0;
+    replay_pass(t, s, [&s, &f, &k, sample] (size_t i) {
+        if (i % sample == 0) {
+            f += s.fragmentation();
+            ++k;}});
+    state.counters["failed"]        = failed;
+    state.counters["fragmentation"] = (k == 0) ? 0 : f / k;}
+
+// the synthetic trace of range(0)
+template <typename P>
+static void BM_placement (benchmark::State& state) {
+    placement<P, ARENA>(state, trace(state.range(0)));}
+
+BENCHMARK_TEMPLATE(BM_placement, GoodFit)              ->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_placement, BestFit)              ->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_placement, AddressOrderedBestFit)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_placement, FirstFit)             ->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_placement, NextFit)              ->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+/**
+ * every policy on a trace recorded to a file, see ReplayAllocator -r
+ */
+template <typename P>
+static void file (const char* policy, const string& name, const Trace& t) {
+    benchmark::RegisterBenchmark(("BM_placement<" + string(policy) + ">/" + name).c_str(),
+                                 [&t] (benchmark::State& state) {placement<P, RECORDED>(state, t);})
+        ->Unit(benchmark::kMillisecond);}
+
+// ----
+// main
+// ----
+
+// ./BenchAllocator [benchmark flags] [trace...]
+int main (int argc, char** argv) {
+    benchmark::Initialize(&argc, argv);
+    vector<unique_ptr<Trace> > files;
+    for (int i = 1; i != argc; ++i) {
+        files.emplace_back(new Trace);
+        ifstream r(argv[i], ios_base::binary);
+        if (!files.back()->read(r)) {
+            cerr << argv[i] << " is not a trace\n";
+            return 1;}
+        const Trace& t = *files.back();
+        file<GoodFit>              ("GoodFit",               argv[i], t);
+        file<BestFit>              ("BestFit",               argv[i], t);
+        file<AddressOrderedBestFit>("AddressOrderedBestFit", argv[i], t);
+        file<FirstFit>             ("FirstFit",              argv[i], t);
+        file<NextFit>              ("NextFit",               argv[i], t);}
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;}
+
+/*
+% g++ -pedantic -std=c++11 -Wall -O3 BenchAllocator.c++ -o BenchAllocator -lbenchmark -pthread
+
+
+
+% ./BenchAllocator
+% ./ReplayAllocator -r map.trace
+% ./BenchAllocator map.trace
+*/
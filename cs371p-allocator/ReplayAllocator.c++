@@ -0,0 +1,150 @@
+// --------------------------------------
+// projects/allocator/ReplayAllocator.c++
+// Copyright (C) 2015
+// Glenn P. Downing
+// --------------------------------------
+
+// --------
+// includes
+// --------
+
+#include <cstring>  // strcmp
+#include <fstream>  // ifstream, ofstream
+#include <iomanip>  // fixed, setprecision, setw
+#include <iostream> // cerr, cout, ios_base
+#include <list>     // list
+#include <map>      // map
+#include <memory>   // unique_ptr
+#include <random>   // mt19937, uniform_int_distribution
+#include <string>   // string
+
+#include "gtest/gtest_prod.h"
+
+#define ALLOCATOR_STATS
+#include "Allocator.h"
+#include "Trace.h"
+
+using namespace std;
+
+// the bytes of every Allocator replayed against
+#define ARENA (64 << 20)
+
+// ------
+// record
+// ------
+
+/**
+ * record a std::map and a std::list of strings growing and shrinking at random
+ */
+static void record (Trace& t) {
+    typedef TracingAllocator<char>                                               char_allocator;
+    typedef basic_string<char, char_traits<char>, char_allocator>                string_type;
+    typedef TracingAllocator<pair<const int, string_type> >                      map_allocator;
+    typedef TracingAllocator<string_type>                                        list_allocator;
+    map<int, string_type, less<int>, map_allocator> m((map_allocator(t)));
+    list<string_type, list_allocator>               l((list_allocator(t)));
+    mt19937                                         g(371);
+    uniform_int_distribution<>                      k(0, 9999), n(1, 200);
+    for (int i = 0; i != 200000; ++i) {
+        const int j = k(g);
+        if (j % 3 == 0)
+            m.erase(j);
+        else
+            m.emplace(j, string_type(n(g), 'x', char_allocator(t)));
+        if (j % 5 == 0)
+            l.push_back(string_type(n(g), 'y', char_allocator(t)));
+        else if ((j % 5 == 1) && !l.empty())
+            l.pop_front();}}
+
+// -----
+// print
+// -----
+
+static void print (const char* name, const Replay& r) {
+    cout << setw(24) << left << name << right
+         << setw(10) << r.mean
+         << setw(10) << r.p50
+         << setw(10) << r.p99
+         << setw(10) << r.p999
+         << setw(12) << r.max
+         << setw(14) << r.peak
+         << setw(8)  << r.failed << "\n";}
+
+/**
+ * the fragmentation at every sample, on one line
+ */
+static void series (const char* name, const Replay& r) {
+    cout << name << setprecision(4);
+    for (double f : r.fragmentation)
+        cout << " " << f;
+    cout << "\n";}
+
+// -----
+// arena
+// -----
+
+template <typename P>
+static Replay arena (const Trace& t, size_t sample) {
+    unique_ptr<Allocator<char, ARENA, P> > x(new Allocator<char, ARENA, P>);
+    Arena<Allocator<char, ARENA, P> >      s(*x);
+    return replay(t, s, sample);}
+
+// ----
+// main
+// ----
+
+int main (int argc, char** argv) {
+    ios_base::sync_with_stdio(false);
+    if ((argc == 3) && (strcmp(argv[1], "-r") == 0)) {
+        Trace t;
+        record(t);
+        ofstream w(argv[2], ios_base::binary);
+        t.write(w);
+        cout << t.ops().size() << " ops\n";
+        return w ? 0 : 1;}
+    if ((argc != 2) && (argc != 3)) {
+        cerr << "usage: " << argv[0] << " trace [sample]\n"
+             << "       " << argv[0] << " -r trace\n";
+        return 2;}
+    Trace    t;
+    ifstream r(argv[1], ios_base::binary);
+    if (!t.read(r)) {
+        cerr << argv[1] << " is not a trace\n";
+        return 1;}
+    const size_t sample = (argc == 3) ? stoul(argv[2]) : 1000;
+
+    const char* names[] = {"malloc", "GoodFit", "BestFit", "AddressOrderedBestFit", "NextFit", "FirstFit"};
+    Replay      s[6];
+    Malloc      m;
+    s[0] = replay(t, m, sample);
+    s[1] = arena<GoodFit>              (t, sample);
+    s[2] = arena<BestFit>              (t, sample);
+    s[3] = arena<AddressOrderedBestFit>(t, sample);
+    s[4] = arena<NextFit>              (t, sample);
+    s[5] = arena<FirstFit>             (t, sample);
+
+    cout << fixed << setprecision(1);
+    cout << t.ops().size() << " ops, times in ns, peak in bytes, fragmentation every " << sample << " ops\n\n";
+    cout << setw(24) << left << "" << right
+         << setw(10) << "mean"
+         << setw(10) << "p50"
+         << setw(10) << "p99"
+         << setw(10) << "p99.9"
+         << setw(12) << "max"
+         << setw(14) << "peak"
+         << setw(8)  << "failed" << "\n";
+    for (int i = 0; i != 6; ++i)
+        print(names[i], s[i]);
+    cout << "\n";
+    for (int i = 1; i != 6; ++i)
+        series(names[i], s[i]);
+    return 0;}
+
+/*
+% g++ -pedantic -std=c++11 -Wall -O3 ReplayAllocator.c++ -o ReplayAllocator -pthread
+
+
+
+% ./ReplayAllocator -r map.trace
+% ./ReplayAllocator map.trace 10000
+*/
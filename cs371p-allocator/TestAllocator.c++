@@ -8,12 +8,33 @@
 // includes
 // --------
 
-#include <algorithm> // count
+#include <algorithm> // count, fill, find, sort
+#include <cstdint>   // uint64_t
+#include <functional> // less
+#include <list>      // list
+#include <map>       // map
 #include <memory>    // allocator
+#include <sstream>   // istringstream, ostringstream
+#include <string>    // string
+#include <thread>    // thread
+#include <utility>   // make_pair, pair
+#include <vector>    // vector
 
 #include "gtest/gtest.h"
 
+#define ALLOCATOR_STATS
 #include "Allocator.h"
+#include "Trace.h"
+
+// the bytes ALLOCATOR_CANARY adds to every block of Ts, 0 without it
+template <typename T>
+static int slack () {
+    return static_cast<int>(Blocks<T>::slack);}
+
+// the end sentinel of the block with n bytes of payload at p
+template <typename T>
+static int& end_of (T* p, int n) {
+    return *reinterpret_cast<int*>(reinterpret_cast<char*>(p) + n + slack<T>());}
 
 // --------------
 // TestAllocator1
@@ -34,7 +55,11 @@ typedef testing::Types<
             std::allocator<int>,
             std::allocator<double>,
             Allocator<int,    100>,
-            Allocator<double, 100> >
+            Allocator<double, 100>,
+            Allocator<int,    100, BestFit>,
+            Allocator<double, 100, AddressOrderedBestFit>,
+            Allocator<int,    100, FirstFit>,
+            Allocator<double, 100, NextFit> >
         my_types_1;
 
 TYPED_TEST_CASE(TestAllocator1, my_types_1);
@@ -107,7 +132,11 @@ struct TestAllocator3 : testing::Test {
 
 typedef testing::Types<
             Allocator<int,    100>,
-            Allocator<double, 100> >
+            Allocator<double, 100>,
+            ConcurrentAllocator<int,    100>,
+            ConcurrentAllocator<double, 100>,
+            HeapAllocator<int>,
+            HeapAllocator<double> >
         my_types_2;
 
 TYPED_TEST_CASE(TestAllocator3, my_types_2);
@@ -187,6 +216,7 @@ TEST(TestAllocator4, valid_2){
     x.allocate(s);
     ASSERT_TRUE(x.valid());}
 
+#ifndef ALLOCATOR_CANARY // the blocks below are laid out without slack
 TEST(TestAllocator4, valid_3) {
     Allocator<double, 100> x;
     x[0] = 32;
@@ -194,6 +224,7 @@ TEST(TestAllocator4, valid_3) {
     x[40] = -52;
     x[96] = -52;
     ASSERT_TRUE(x.valid());}
+#endif
 
 //Test Allocator
 
@@ -220,7 +251,7 @@ TEST(TestAllocator5, Allocator__3) {
 TEST(TestAllocator6, allocate_1) {
     Allocator<double, 200> x;
     x.allocate(8);
-    ASSERT_EQ(x[0], -64);}
+    ASSERT_EQ(x[0], -(64 + slack<double>()));}
 
 // Find no fit, throw bad_alloc
 TEST(TestAllocator6, allocate_2) {
@@ -250,13 +281,13 @@ TEST(TestAllocator6, allocate_4) {
 
 // Allocate many sentinels
 TEST(TestAllocator6, allocate_5) {
-    Allocator<int, 100> x;
+    Allocator<int, 200> x;
     int s = 20;
     int*         p = x.allocate(s);
-    int* _end = (p+s);
+    int* _end = &end_of(p, s * sizeof(int));
     int* _header = p-1;
-    ASSERT_TRUE(*_header == -80);
-    ASSERT_TRUE(*_end ==-80);}
+    ASSERT_TRUE(*_header == -(80 + slack<int>()));
+    ASSERT_TRUE(*_end == -(80 + slack<int>()));}
 
 // Test deallocate
 
@@ -271,16 +302,16 @@ TEST(TestAllocator7, deallocate_1) {
 
 //Deallocate multiple blocks
 TEST(TestAllocator7, deallocate_2) {
-    Allocator<int, 100> x;
+    Allocator<int, 200> x;
     int s = 20;
     int*         p = x.allocate(s);
-    int* _end = (p+s);
+    int* _end = &end_of(p, s * sizeof(int));
     int* _header = p-1;
-    ASSERT_TRUE(*_header == -80);
-    ASSERT_TRUE(*_end ==-80);
+    ASSERT_TRUE(*_header == -(80 + slack<int>()));
+    ASSERT_TRUE(*_end == -(80 + slack<int>()));
     if (p != 0)
         x.deallocate(p, s);
-    ASSERT_TRUE(*_header == 92);
+    ASSERT_TRUE(*_header == 192);
 }
 
 //Throw invalid_argument
@@ -308,7 +339,7 @@ TEST(TestAllocator7, deallocate_4) {
 
 // coalesce before block
 TEST(TestAllocator7, deallocate_5) {
-    Allocator<double, 200> x;
+    Allocator<double, 400> x;
     x.allocate(10);
     double* ptr1 = x.allocate(10);
     double* ptr2 = x.allocate(5);
@@ -317,3 +348,600 @@ TEST(TestAllocator7, deallocate_5) {
     x.deallocate(ptr2, s);
     double* ptr3 = x.allocate(20);
     ASSERT_EQ(ptr1, ptr3);}
+
+// Throw invalid_argument for a pointer into the middle of a block
+TEST(TestAllocator7, deallocate_6) {
+    Allocator<int, 100> x;
+    int* p = x.allocate(5);
+    ASSERT_THROW(x.deallocate(p + 2, 5), std::invalid_argument);
+    x.deallocate(p, 5);
+    ASSERT_THROW(x.deallocate(p, 5), std::invalid_argument);}
+
+// Test free lists
+
+// Fill the holes left by every other block
+TEST(TestAllocator8, free_list_1) {
+    Allocator<double, 1000> x;
+    double* p[10];
+    for (int i = 0; i != 10; ++i)
+        p[i] = x.allocate(5);
+    for (int i = 0; i != 10; i += 2)
+        x.deallocate(p[i], 5);
+    ASSERT_TRUE(x.valid());
+    for (int i = 0; i != 10; i += 2) {
+        double* q = x.allocate(5);
+        ASSERT_NE(p + 10, std::find(p, p + 10, q));}
+    ASSERT_TRUE(x.valid());}
+
+#ifndef ALLOCATOR_CANARY // the blocks below are laid out without slack
+// Blocks too small to link still coalesce
+TEST(TestAllocator8, free_list_2) {
+    Allocator<char, 100> x;
+    char* p = x.allocate(1);
+    char* q = x.allocate(1);
+    char* r = x.allocate(1);
+    x.deallocate(q, 1);
+    ASSERT_EQ(1, x[9]);
+    x.deallocate(p, 1);
+    x.deallocate(r, 1);
+    ASSERT_EQ(92, x[0]);
+    ASSERT_TRUE(x.valid());}
+#endif
+
+// Random sequence, no two live blocks overlap
+TEST(TestAllocator8, free_list_3) {
+    Allocator<int, 4000> x;
+    std::vector<std::pair<int*, int>> live;
+    unsigned int r = 1;
+    for (int i = 0; i != 2000; ++i) {
+        r = r * 1103515245 + 12345;
+        if (!live.empty() && ((r >> 16) % 3 == 0)) {
+            const std::size_t k = (r >> 8) % live.size();
+            x.deallocate(live[k].first, live[k].second);
+            live.erase(live.begin() + k);}
+        else {
+            const int n = 1 + (r >> 16) % 40;
+            try {
+                int* p = x.allocate(n);
+                std::fill(p, p + n, i);
+                live.push_back(std::make_pair(p, n));}
+            catch (std::bad_alloc&) {}}
+        ASSERT_TRUE(x.valid());}
+    for (std::size_t k = 0; k != live.size(); ++k)
+        ASSERT_EQ(live[k].second, std::count(live[k].first, live[k].first + live[k].second, live[k].first[0]));}
+
+// Test ConcurrentAllocator
+
+// Threads allocating and freeing their own blocks
+TEST(TestAllocator9, concurrent_1) {
+    ConcurrentAllocator<int, 20000> x;
+    std::vector<std::thread> t;
+    for (int k = 0; k != 4; ++k)
+        t.push_back(std::thread([&x, k] () {
+            std::vector<std::pair<int*, int>> live;
+            unsigned int r = k + 1;
+            for (int i = 0; i != 5000; ++i) {
+                r = r * 1103515245 + 12345;
+                if (!live.empty() && ((r >> 16) % 2 == 0)) {
+                    const std::size_t j = (r >> 8) % live.size();
+                    ASSERT_EQ(live[j].second, std::count(live[j].first, live[j].first + live[j].second, live[j].first[0]));
+                    x.deallocate(live[j].first, live[j].second);
+                    live.erase(live.begin() + j);}
+                else if (live.size() < 100) {
+                    const int n = 1 + (r >> 16) % 10;
+                    int*      p = x.allocate(n);
+                    std::fill(p, p + n, k * 10000 + i);
+                    live.push_back(std::make_pair(p, n));}}
+            for (std::size_t j = 0; j != live.size(); ++j)
+                x.deallocate(live[j].first, live[j].second);
+            x.flush();}));
+    for (std::size_t k = 0; k != t.size(); ++k)
+        t[k].join();
+    ASSERT_TRUE(x.valid());
+    const Allocator<int, 20000>& a = x.arena;
+    ASSERT_EQ(19992, a[0]);}
+
+// Blocks freed by another thread go back to the thread that allocated them
+TEST(TestAllocator9, concurrent_2) {
+    ConcurrentAllocator<double, 4000> x;
+    std::vector<double*> p;
+    try {
+        while (true)
+            p.push_back(x.allocate(1));}
+    catch (std::bad_alloc&) {}
+    ASSERT_LT(150u, p.size());
+    // the other thread exits without flushing, so only the remote list can bring them back
+    std::thread t([&x, &p] () {
+        for (std::size_t i = 0; i != p.size(); ++i)
+            x.deallocate(p[i], 1);});
+    t.join();
+    std::vector<double*> q;
+    for (std::size_t i = 0; i != p.size(); ++i)
+        q.push_back(x.allocate(1));
+    std::sort(p.begin(), p.end());
+    std::sort(q.begin(), q.end());
+    ASSERT_TRUE(p == q);
+    for (std::size_t i = 0; i != q.size(); ++i)
+        x.deallocate(q[i], 1);
+    x.flush();
+    ASSERT_TRUE(x.valid());
+    const Allocator<double, 4000>& a = x.arena;
+    ASSERT_EQ(3992, a[0]);}
+
+// A thread that exits gives its slot back, and blocks freed after it went go to the arena
+TEST(TestAllocator9, concurrent_3) {
+    ConcurrentAllocator<double, 4000> x;
+    std::vector<double*> p;
+    std::thread t([&x, &p] () {
+        for (int n = 1; n != 9; ++n)
+            for (int i = 0; i != 4; ++i)
+                p.push_back(x.allocate(n));});
+    t.join();
+    for (std::size_t i = 0; i != p.size(); ++i)
+        x.deallocate(p[i], 1);
+    x.flush();
+    ASSERT_TRUE(x.valid());
+    for (int s = 0; s != 16; ++s)
+        ASSERT_EQ(0u, x.slots[s].owner.load());
+    const Allocator<double, 4000>& a = x.arena;
+    ASSERT_EQ(3992, a[0]);}
+
+// Test HeapAllocator
+
+// The capacity is set at run time
+TEST(TestAllocator10, heap_1) {
+    HeapAllocator<int> x(100);
+    int* p = x.allocate(20);
+    ASSERT_EQ(-(80 + slack<int>()), p[-1]);
+    ASSERT_EQ(-(80 + slack<int>()), end_of(p, 80));
+    x.deallocate(p, 20);
+    ASSERT_TRUE(x.valid());
+    ASSERT_THROW(HeapAllocator<int>(7), std::bad_alloc);}
+
+// Grow by a chunk, give it back once it is empty
+TEST(TestAllocator10, heap_2) {
+    HeapAllocator<double> x(4096);
+    std::vector<double*> p;
+    while (x.chunks() == 1)
+        p.push_back(x.allocate(10));
+    ASSERT_EQ(2u, x.chunks());
+    p.push_back(x.allocate(10));
+    ASSERT_TRUE(x.valid());
+    for (std::size_t i = p.size(); i-- != 0;)
+        x.deallocate(p[i], 10);
+    ASSERT_EQ(1u, x.chunks());
+    ASSERT_TRUE(x.valid());}
+
+// A request larger than the capacity gets a chunk of its own
+TEST(TestAllocator10, heap_3) {
+    HeapAllocator<char> x(4096, true);
+    char* p = x.allocate(10000000);
+    std::fill(p, p + 10000000, 'a');
+    ASSERT_EQ(2u, x.chunks());
+    ASSERT_THROW(x.deallocate(p + 1, 1), std::invalid_argument);
+    x.deallocate(p, 10000000);
+    ASSERT_EQ(1u, x.chunks());
+    ASSERT_TRUE(x.valid());}
+
+// Every request past the capacity fits the chunk mapped for it, slack and all
+TEST(TestAllocator10, heap_4) {
+    HeapAllocator<char> x(4096);
+    char* q = x.allocate(4000);
+    for (std::size_t n = 4000; n != 12500; ++n) {
+        char* p = x.allocate(n);
+        std::fill(p, p + n, 'a');
+        x.deallocate(p, n);}
+    x.deallocate(q, 4000);
+    ASSERT_TRUE(x.valid());}
+
+// Test ArenaAllocator
+
+// Copies and rebindings share one arena
+TEST(TestAllocator11, arena_1) {
+    HeapAllocator<std::uint64_t> h(4096);
+    HeapAllocator<std::uint64_t> i(4096);
+    ArenaAllocator<int>    x(h);
+    ArenaAllocator<double> y(x);
+    ASSERT_TRUE(x == y);
+    ASSERT_TRUE(x != ArenaAllocator<int>(i));
+    ASSERT_FALSE((Allocator<int, 100>() == Allocator<int, 100>()));
+    double* p = y.allocate(3);
+    ASSERT_EQ(0u, reinterpret_cast<std::uintptr_t>(p) % 8);
+    ArenaAllocator<double>(x).deallocate(p, 3);}
+
+// Containers
+TEST(TestAllocator11, arena_2) {
+    typedef std::pair<const int, int> value_type;
+    HeapAllocator<std::uint64_t> h(4096);
+    {
+    std::vector<int, ArenaAllocator<int> > v((ArenaAllocator<int>(h)));
+    std::list<int, ArenaAllocator<int> >   l((ArenaAllocator<int>(h)));
+    std::map<int, int, std::less<int>, ArenaAllocator<value_type> > m((std::less<int>()), ArenaAllocator<value_type>(h));
+    for (int i = 0; i != 1000; ++i) {
+        v.push_back(i);
+        l.push_front(i);
+        m[i] = -i;}
+    ASSERT_EQ(999, v.back());
+    ASSERT_EQ(999, l.front());
+    ASSERT_EQ(-999, m[999]);
+    ASSERT_LT(1u, h.chunks());
+    ASSERT_TRUE(h.valid());
+    }
+    ASSERT_EQ(1u, h.chunks());
+    ASSERT_TRUE(h.valid());}
+
+// The arena follows the container on assignment
+TEST(TestAllocator11, arena_3) {
+    HeapAllocator<std::uint64_t> h(4096);
+    HeapAllocator<std::uint64_t> i(4096);
+    std::list<int, ArenaAllocator<int> > x(10, 1, ArenaAllocator<int>(h));
+    std::list<int, ArenaAllocator<int> > y(20, 2, ArenaAllocator<int>(i));
+    x = y;
+    ASSERT_TRUE(x.get_allocator() == ArenaAllocator<int>(i));
+    ASSERT_EQ(20u, x.size());
+    x.swap(y);
+    ASSERT_TRUE(y.get_allocator() == ArenaAllocator<int>(i));}
+
+// Every block of a heap or an arena stays word aligned, with or without ALLOCATOR_CANARY
+TEST(TestAllocator11, arena_4) {
+    HeapAllocator<std::uint64_t> h(4096);
+    ArenaAllocator<double>       x(h);
+    HeapAllocator<double>        y(4096);
+    double* p[4];
+    double* q[4];
+    for (int i = 0; i != 4; ++i) {
+        p[i] = x.allocate(3);
+        q[i] = y.allocate(3);
+        ASSERT_EQ(0u, reinterpret_cast<std::uintptr_t>(p[i]) % 8);
+        ASSERT_EQ(0u, reinterpret_cast<std::uintptr_t>(q[i]) % 8);}
+    for (int i = 0; i != 4; ++i) {
+        x.deallocate(p[i], 3);
+        y.deallocate(q[i], 3);}}
+
+// Test PoolAllocator
+
+// Objects are packed with no sentinels
+TEST(TestAllocator12, pool_1) {
+    PoolAllocator<double, 100> x;
+    double* p = x.allocate(1);
+    double* q = x.allocate(1);
+    ASSERT_EQ(p + 1, q);
+    ASSERT_THROW(x.allocate(2), std::bad_alloc);
+    ASSERT_THROW(x.deallocate(reinterpret_cast<double*>(reinterpret_cast<char*>(q) + 4), 1), std::invalid_argument);
+    x.construct(q, 2.5);
+    ASSERT_EQ(2.5, *q);
+    x.destroy(q);
+    x.deallocate(q, 1);
+    x.deallocate(p, 1);}
+
+// Freed slots come back first, last in first out
+TEST(TestAllocator12, pool_2) {
+    PoolAllocator<int, 400> x;
+    std::vector<int*> p;
+    for (int i = 0; i != 100; ++i)
+        p.push_back(x.allocate(1));
+    ASSERT_THROW(x.allocate(1), std::bad_alloc);
+    for (int i = 0; i < 100; i += 3)
+        x.deallocate(p[i], 1);
+    ASSERT_TRUE(x.valid());
+    for (int i = 99; i >= 0; i -= 3)
+        ASSERT_EQ(p[i], x.allocate(1));
+    ASSERT_TRUE(x.valid());}
+
+// Slots hold at least a link
+TEST(TestAllocator12, pool_3) {
+    PoolAllocator<char, 10> x;
+    char* p = x.allocate(1);
+    char* q = x.allocate(1);
+    ASSERT_EQ(p + 4, q);
+    ASSERT_THROW(x.allocate(1), std::bad_alloc);}
+
+// ---------------
+// TestAllocator13
+// ---------------
+
+#ifndef ALLOCATOR_CANARY // the blocks below are laid out without slack
+// The counters follow allocate and deallocate, the walk the blocks
+TEST(TestAllocator13, stats_1) {
+    Allocator<double, 100> x;
+    double* p = x.allocate(2);
+    double* q = x.allocate(1);
+    Statistics t = x.stats();
+    ASSERT_EQ(2u,  t.allocations);
+    ASSERT_EQ(24u, t.live);
+    ASSERT_EQ(24u, t.in_use);
+    ASSERT_EQ(2u,  t.used_blocks);
+    ASSERT_EQ(52u, t.free);
+    ASSERT_EQ(52u, t.largest);
+    ASSERT_EQ(0,   t.fragmentation());
+    ASSERT_EQ(1u,  t.histogram[3]);
+    ASSERT_EQ(1u,  t.histogram[4]);
+    x.deallocate(p, 2);
+    t = x.stats();
+    ASSERT_EQ(1u,  t.frees);
+    ASSERT_EQ(8u,  t.live);
+    ASSERT_EQ(24u, t.peak);
+    ASSERT_EQ(2u,  t.free_blocks);
+    ASSERT_EQ(68u, t.free);
+    ASSERT_DOUBLE_EQ(1 - 52.0 / 68, t.fragmentation());
+    x.deallocate(q, 1);
+    t = x.stats();
+    ASSERT_EQ(0u,  t.live);
+    ASSERT_EQ(92u, t.largest);}
+
+// A heap map has a line per block, or one JSON object
+TEST(TestAllocator13, stats_2) {
+    Allocator<double, 100> x;
+    double* p = x.allocate(2);
+    std::ostringstream w;
+    x.dump(w);
+    ASSERT_EQ(0u, w.str().find("allocations 1 frees 0 live 16 peak 16"));
+    ASSERT_NE(std::string::npos, w.str().find("\n0 16 used\n24 68 free\n"));
+    w.str("");
+    x.dump(w, true);
+    ASSERT_EQ(0u, w.str().find("{\"allocations\": 1, "));
+    ASSERT_NE(std::string::npos, w.str().find("\"blocks\": [[0, 16, true], [24, 68, false]]}\n"));
+    x.deallocate(p, 2);}
+
+// A heap sums its chunks
+TEST(TestAllocator13, stats_3) {
+    HeapAllocator<double> x(4096);
+    double* p = x.allocate(1000);
+    double* q = x.allocate(1000);
+    ASSERT_EQ(2u, x.chunks());
+    Statistics t = x.stats();
+    ASSERT_EQ(16000u, t.in_use);
+    ASSERT_EQ(2u,     t.used_blocks);
+    ASSERT_EQ(2u,     t.free_blocks);
+    std::ostringstream w;
+    x.dump(w, true);
+    ASSERT_NE(std::string::npos, w.str().find("\"chunks\": [[[0, 8000, true], "));
+    x.deallocate(q, 1000);
+    x.deallocate(p, 1000);
+    ASSERT_EQ(16000u, x.stats().peak);}
+#endif
+
+// ---------------
+// TestAllocator14
+// ---------------
+
+// Free blocks of 10, 3 and 3 doubles, in that order, with used ones between
+template <typename P>
+void fragment (Allocator<double, 1000, P>& x, double* p[6]) {
+    const int n[] = {10, 1, 3, 1, 3, 1};
+    for (int i = 0; i != 6; ++i)
+        p[i] = x.allocate(n[i]);
+    x.deallocate(p[0], 10);
+    x.deallocate(p[2], 3);
+    x.deallocate(p[4], 3);}
+
+#ifndef ALLOCATOR_CANARY // the blocks below are laid out without slack
+// Each policy picks its own block for the same request
+TEST(TestAllocator14, policy_1) {
+    double* p[6];
+    Allocator<double, 1000, FirstFit> a;
+    fragment(a, p);
+    ASSERT_EQ(p[0], a.allocate(3));
+    Allocator<double, 1000, BestFit> b;
+    fragment(b, p);
+    ASSERT_EQ(p[4], b.allocate(3));
+    Allocator<double, 1000, AddressOrderedBestFit> c;
+    fragment(c, p);
+    ASSERT_EQ(p[2], c.allocate(3));
+    Allocator<double, 1000, NextFit> d;
+    fragment(d, p);
+    ASSERT_EQ(p[5] + 2, d.allocate(3));
+    d.allocate(95);
+    ASSERT_EQ(p[0], d.allocate(3));}
+
+// The rover survives the block under it coalescing away
+TEST(TestAllocator14, policy_2) {
+    Allocator<double, 1000, NextFit> x;
+    double* p = x.allocate(3);
+    double* q = x.allocate(3);
+    double* r = x.allocate(3);
+    double* s = x.allocate(112);
+    ASSERT_EQ(r + 4, s);
+    x.deallocate(q, 3);
+    ASSERT_EQ(q, x.allocate(2));
+    x.deallocate(p, 3);
+    x.deallocate(q, 2);
+    ASSERT_EQ(p, x.allocate(7));
+    ASSERT_THROW(x.allocate(1), std::bad_alloc);}
+#endif
+
+// Random sequence, the blocks still add up to N and no two live blocks overlap
+template <typename P>
+void shuffle () {
+    Allocator<int, 4000, P> x;
+    std::vector<std::pair<int*, int>> live;
+    unsigned int r = 1;
+    for (int i = 0; i != 2000; ++i) {
+        r = r * 1103515245 + 12345;
+        if (!live.empty() && ((r >> 16) % 3 == 0)) {
+            const std::size_t k = (r >> 8) % live.size();
+            x.deallocate(live[k].first, live[k].second);
+            live.erase(live.begin() + k);}
+        else {
+            const int n = 1 + (r >> 16) % 40;
+            try {
+                int* p = x.allocate(n);
+                std::fill(p, p + n, i);
+                live.push_back(std::make_pair(p, n));}
+            catch (std::bad_alloc&) {}}
+        const Statistics t = x.stats();
+        ASSERT_EQ(4000u, t.in_use + t.free + 8 * (t.used_blocks + t.free_blocks));}
+    for (std::size_t k = 0; k != live.size(); ++k)
+        ASSERT_EQ(live[k].second, std::count(live[k].first, live[k].first + live[k].second, live[k].first[0]));}
+
+TEST(TestAllocator14, policy_3) {
+    shuffle<GoodFit>();
+    shuffle<BestFit>();
+    shuffle<AddressOrderedBestFit>();
+    shuffle<FirstFit>();
+    shuffle<NextFit>();}
+
+// ---------------
+// TestAllocator15
+// ---------------
+
+#ifndef ALLOCATOR_CANARY // the blocks below are laid out without slack
+// k blocks come out of one free block, back to back
+TEST(TestAllocator15, bulk_1) {
+    Allocator<double, 1000> x;
+    double* p[10];
+    x.allocate_n(p, 10, 3);
+    for (int i = 1; i != 10; ++i)
+        ASSERT_EQ(p[i - 1] + 4, p[i]);
+    const Statistics t = x.stats();
+    ASSERT_EQ(10u,  t.allocations);
+    ASSERT_EQ(240u, t.in_use);
+    ASSERT_EQ(1u,   t.free_blocks);
+    x.deallocate_n(p, 10, 3);
+    ASSERT_EQ(992u, x.stats().largest);}
+
+// All or nothing
+TEST(TestAllocator15, bulk_2) {
+    Allocator<double, 1000> x;
+    double* q = x.allocate(1);
+    double* p[40];
+    ASSERT_THROW(x.allocate_n(p, 40, 3), std::bad_alloc);
+    ASSERT_EQ(1u, x.stats().used_blocks);
+    ASSERT_EQ(1u, x.stats().free_blocks);
+    x.allocate_n(p, 30, 3);
+    ASSERT_EQ(q + 2, p[0]);
+    x.deallocate(q, 1);
+    ASSERT_EQ(2u, x.stats().free_blocks);}
+#endif
+
+// One sweep frees any order and merges free neighbours, and a bad set frees nothing
+TEST(TestAllocator15, bulk_3) {
+    Allocator<double, 1000> x;
+    double* p[8];
+    x.allocate_n(p, 8, 2);
+    x.deallocate(p[3], 2);
+    double* q[] = {p[6], p[0], p[2], p[1], p[4], p[7]};
+    double* r[] = {p[5], p[5]};
+    ASSERT_THROW(x.deallocate_n(r, 2, 2), std::invalid_argument);
+    double* s[] = {p[5], p[3]};
+    ASSERT_THROW(x.deallocate_n(s, 2, 2), std::invalid_argument);
+    ASSERT_EQ(7u, x.stats().used_blocks);
+    x.deallocate_n(q, 6, 2);
+    ASSERT_EQ(q[0], p[0]);
+    const Statistics t = x.stats();
+    ASSERT_EQ(1u, t.used_blocks);
+    ASSERT_EQ(2u, t.free_blocks);
+    x.deallocate(p[5], 2);
+    ASSERT_EQ(992u, x.stats().largest);}
+
+// ---------------
+// TestAllocator16
+// ---------------
+
+// A trace comes back the same from its bytes, and bad bytes are refused
+TEST(TestAllocator16, trace_1) {
+    Trace t;
+    int a[3];
+    t.allocate(a,     4);
+    t.allocate(a + 1, 300);
+    t.deallocate(a);
+    t.allocate(a,     8);
+    t.deallocate(a + 1);
+    t.deallocate(a);
+    ASSERT_THROW(t.deallocate(a + 2), std::invalid_argument);
+    std::ostringstream w;
+    t.write(w);
+    ASSERT_EQ(std::string("ATR1\x06\x08\xD8\x04\x03\x10\x03\x01", 12), w.str());
+    Trace u;
+    std::istringstream r(w.str());
+    ASSERT_TRUE(u.read(r));
+    ASSERT_EQ(3u, u.allocations());
+    ASSERT_EQ(6u, u.ops().size());
+    ASSERT_TRUE(u.ops()[2].free);
+    ASSERT_EQ(0u, u.ops()[2].value);
+    ASSERT_EQ(300u, u.ops()[1].value);
+    std::istringstream s(std::string("ATR1\x02\x08\x03", 8));
+    ASSERT_FALSE(u.read(s));
+    std::istringstream v(std::string("ATR1\x03\x08\x01\x01", 9));
+    ASSERT_FALSE(u.read(v));
+    ASSERT_EQ(6u, u.ops().size());}
+
+// Containers record through a TracingAllocator
+TEST(TestAllocator16, trace_2) {
+    Trace t;
+    {
+    std::list<int, TracingAllocator<int> > x((TracingAllocator<int>(t)));
+    x.push_back(1);
+    x.push_back(2);
+    x.pop_front();
+    }
+    ASSERT_EQ(2u, t.allocations());
+    ASSERT_EQ(4u, t.ops().size());
+    ASSERT_FALSE(t.ops()[1].free);
+    ASSERT_EQ(0u, t.ops()[2].value);
+    ASSERT_EQ(1u, t.ops()[3].value);}
+
+#ifndef ALLOCATOR_CANARY // the blocks below are laid out without slack
+// A replay fails what does not fit and leaves the arena empty
+TEST(TestAllocator16, trace_3) {
+    Trace t;
+    int a[100];
+    for (int i = 0; i != 100; ++i)
+        t.allocate(a + i, 10);
+    for (int i = 0; i != 100; i += 2)
+        t.deallocate(a + i);
+    Allocator<char, 1000> x;
+    Arena<Allocator<char, 1000> > s(x);
+    const Replay r = replay(t, s, 50);
+    ASSERT_EQ(150u, r.ops);
+    ASSERT_EQ(45u,  r.failed);
+    ASSERT_EQ(3u,   r.fragmentation.size());
+    ASSERT_EQ(990u, r.peak);
+    ASSERT_LE(r.p50, r.max);
+    ASSERT_EQ(0u, x.stats().used_blocks);
+    Malloc m;
+    ASSERT_EQ(0u, replay(t, m).failed);}
+#endif
+
+// ---------------
+// TestAllocator17
+// ---------------
+
+#if !defined(NDEBUG) && (ALLOCATOR_CHECK >= 1)
+// Freeing a block checks the sentinels of its neighbours
+TEST(TestAllocator17, check_1) {
+    Allocator<double, 100> x;
+    double* p = x.allocate(1);
+    double* q = x.allocate(1);
+    end_of(q, 8) = 5;
+    EXPECT_DEATH(x.deallocate(p, 1), "local");}
+
+// So does allocating one, next to a block whose end was overwritten
+TEST(TestAllocator17, check_2) {
+    Allocator<double, 100> x;
+    double* p = x.allocate(1);
+    double* q = x.allocate(1);
+    x.deallocate(q, 1);
+    end_of(p, 8) = 5;
+    EXPECT_DEATH(x.allocate(1), "local");}
+#endif
+
+#if !defined(NDEBUG) && defined(ALLOCATOR_CANARY)
+// Writing one int past the end of a block breaks its canary, caught when it is freed
+TEST(TestAllocator17, check_3) {
+    Allocator<double, 100> x;
+    double* p = x.allocate(1);
+    *reinterpret_cast<int*>(p + 1) = 0;
+    ASSERT_NE(0, end_of(p, 8));
+    EXPECT_DEATH(x.deallocate(p, 1), "local|intact");}
+#endif
+
+#if !defined(NDEBUG) && defined(ALLOCATOR_POISON)
+// Writing to a block after freeing it breaks its poison, caught when it is allocated again
+TEST(TestAllocator17, check_4) {
+    Allocator<double, 100> x;
+    double* p = x.allocate(4);
+    x.deallocate(p, 4);
+    p[3] = 1;
+    EXPECT_DEATH(x.allocate(4), "filled");}
+#endif
@@ -0,0 +1,466 @@
+#ifndef Trace_h
+#define Trace_h
+
+// --------
+// includes
+// --------
+
+#include <algorithm>     // max, sort
+#include <chrono>        // duration, steady_clock
+#include <cstddef>       // ptrdiff_t, size_t
+#include <cstdint>       // uint64_t
+#include <cstdlib>       // free, malloc
+#include <istream>       // istream
+#include <memory>        // allocator, allocator_traits
+#include <mutex>         // lock_guard, mutex
+#include <new>           // bad_alloc
+#include <ostream>       // ostream
+#include <stdexcept>     // invalid_argument
+#include <string>        // char_traits
+#include <unordered_map> // unordered_map
+#include <vector>        // vector
+
+#ifdef __GLIBC__
+#include <malloc.h> // mallinfo, mallinfo2
+#endif
+
+// -----
+// Trace
+// -----
+
+/**
+ * a recording of the allocates and deallocates of a program, in bytes
+ * the allocates are numbered from 0 in order, and a deallocate names the
+ * allocate it undoes
+ * written, it is "ATR1", the number of ops, and one varint per op: bytes << 1
+ * for an allocate, and for a deallocate (d << 1) | 1, with d the number of
+ * allocates between the one undone and the end, most often a byte or two
+ * recording may go on from many threads at once
+ */
+class Trace {
+    public:
+        struct Op {
+            std::size_t value; // the bytes of an allocate, or the number of the allocate a deallocate undoes
+            bool        free;};
+
+    private:
+        // ----
+        // data
+        // ----
+
+        std::mutex                                    lock;  // guards everything below
+        std::vector<Op>                               trace;
+        std::size_t                                   count; // allocates so far
+        std::unordered_map<const void*, std::size_t>  live;  // the number of the allocate behind each pointer not freed yet
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        static void put (std::ostream& w, std::uint64_t v) {
+            while (v >= 0x80) {
+                w.put(static_cast<char>(v | 0x80));
+                v >>= 7;}
+            w.put(static_cast<char>(v));}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * return false if r runs out or the varint is too long
+         */
+        static bool get (std::istream& r, std::uint64_t& v) {
+            v = 0;
+            for (int s = 0; s < 64; s += 7) {
+                const int c = r.get();
+                if (c == std::char_traits<char>::eof())
+                    return false;
+                v |= static_cast<std::uint64_t>(c & 0x7F) << s;
+                if ((c & 0x80) == 0)
+                    return true;}
+            return false;}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        Trace () :
+                count (0) {}
+
+        Trace             (const Trace&) = delete;
+        Trace& operator = (const Trace&) = delete;
+
+        // ---
+        // ops
+        // ---
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * the ops, in order, which must not be recording
+         */
+        const std::vector<Op>& ops () const {
+            return trace;}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        std::size_t allocations () const {
+            return count;}
+
+        // --------
+        // allocate
+        // --------
+
+        /**
+         * O(1) in space
+         * O(1) in time, amortized
+         * record an allocate of s bytes at p
+         */
+        void allocate (const void* p, std::size_t s) {
+            std::lock_guard<std::mutex> g(lock);
+            live[p] = count++;
+            trace.push_back({s, false});}
+
+        // ----------
+        // deallocate
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(1) in time, amortized
+         * record a deallocate of p
+         * throw an invalid_argument exception, if p was not recorded as allocated
+         */
+        void deallocate (const void* p) {
+            std::lock_guard<std::mutex> g(lock);
+            const auto i = live.find(p);
+            if (i == live.end())
+                throw std::invalid_argument("Argument was not allocated");
+            trace.push_back({i->second, true});
+            live.erase(i);}
+
+        // -----
+        // write
+        // -----
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         */
+        void write (std::ostream& w) {
+            std::lock_guard<std::mutex> g(lock);
+            w.write("ATR1", 4);
+            put(w, trace.size());
+            std::size_t k = 0;
+            for (const Op& o : trace)
+                if (!o.free) {
+                    put(w, static_cast<std::uint64_t>(o.value) << 1);
+                    ++k;}
+                else
+                    put(w, (static_cast<std::uint64_t>(k - 1 - o.value) << 1) | 1);}
+
+        // ----
+        // read
+        // ----
+
+        /**
+         * O(n) in space
+         * O(n) in time
+         * replace the ops with ones written by write
+         * return false, leaving the trace unchanged, if r does not hold a valid trace,
+         * one that frees an allocate that never happened or that was freed already
+         */
+        bool read (std::istream& r) {
+            char m[4];
+            std::uint64_t n;
+            if (!r.read(m, 4) || !std::equal(m, m + 4, "ATR1") || !get(r, n))
+                return false;
+            std::vector<Op>   t;
+            std::vector<bool> freed;
+            for (std::uint64_t i = 0; i != n; ++i) {
+                std::uint64_t v;
+                if (!get(r, v))
+                    return false;
+                if ((v & 1) == 0) {
+                    t.push_back({static_cast<std::size_t>(v >> 1), false});
+                    freed.push_back(false);}
+                else {
+                    if ((v >> 1) >= freed.size())
+                        return false;
+                    const std::size_t k = freed.size() - 1 - static_cast<std::size_t>(v >> 1);
+                    if (freed[k])
+                        return false;
+                    freed[k] = true;
+                    t.push_back({k, true});}}
+            std::lock_guard<std::mutex> g(lock);
+            trace.swap(t);
+            count = freed.size();
+            live.clear();
+            return true;}};
+
+// ----------------
+// TracingAllocator
+// ----------------
+
+/**
+ * a standard allocator that hands every request to A, std::allocator by
+ * default, and records it in a Trace shared by every copy and rebinding of it
+ * the trace must outlive every container that records into it
+ */
+template <typename T, typename A = std::allocator<T> >
+class TracingAllocator {
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T                 value_type;
+
+        typedef std::size_t       size_type;
+        typedef std::ptrdiff_t    difference_type;
+
+        typedef       value_type*       pointer;
+        typedef const value_type* const_pointer;
+
+        typedef       value_type&       reference;
+        typedef const value_type& const_reference;
+
+        template <typename U>
+        struct rebind {
+            typedef TracingAllocator<U, typename std::allocator_traits<A>::template rebind_alloc<U> > other;};
+
+    private:
+        // ----
+        // data
+        // ----
+
+        Trace* shared;
+        A      inner;
+
+    public:
+        // -----------
+        // operator ==
+        // -----------
+
+        template <typename U, typename B>
+        friend bool operator == (const TracingAllocator& lhs, const TracingAllocator<U, B>& rhs) {
+            return (&lhs.trace() == &rhs.trace()) && (lhs.base() == rhs.base());}
+
+        // -----------
+        // operator !=
+        // -----------
+
+        template <typename U, typename B>
+        friend bool operator != (const TracingAllocator& lhs, const TracingAllocator<U, B>& rhs) {
+            return !(lhs == rhs);}
+
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * @param trace the trace to record into, which must outlive this and every copy of it
+         * @param base  the allocator to hand requests to
+         */
+        explicit TracingAllocator (Trace& trace, const A& base = A()) :
+                shared (&trace),
+                inner  (base) {}
+
+        template <typename U, typename B>
+        TracingAllocator (const TracingAllocator<U, B>& that) :
+                shared (&that.trace()),
+                inner  (that.base()) {}
+
+        // -----
+        // trace
+        // -----
+
+        Trace& trace () const {
+            return *shared;}
+
+        // ----
+        // base
+        // ----
+
+        const A& base () const {
+            return inner;}
+
+        // --------
+        // allocate
+        // --------
+
+        pointer allocate (size_type n) {
+            const pointer p = inner.allocate(n);
+            shared->allocate(p, n * sizeof(T));
+            return p;}
+
+        // ----------
+        // deallocate
+        // ----------
+
+        void deallocate (pointer p, size_type n) {
+            shared->deallocate(p);
+            inner.deallocate(p, n);}};
+
+// ------
+// Malloc
+// ------
+
+/**
+ * malloc and free, to replay a Trace against
+ * the footprint is what glibc has taken from the system, 0 elsewhere,
+ * and the fragmentation is not known
+ */
+struct Malloc {
+    void* allocate (std::size_t s) {
+        if (void* p = std::malloc(s))
+            return p;
+        throw std::bad_alloc();}
+
+    void deallocate (void* p, std::size_t) {
+        std::free(p);}
+
+    std::size_t footprint () const {
+        #ifdef __GLIBC__
+        #if __GLIBC_PREREQ(2, 33)
+        const struct mallinfo2 m = mallinfo2();
+        return m.arena + m.hblkhd;
+        #else
+        const struct mallinfo m = mallinfo(); // ints, which wrap past 2 GB
+        return static_cast<unsigned int>(m.arena) + static_cast<unsigned int>(m.hblkhd);
+        #endif
+        #else
+        return 0;
+        #endif
+        }
+
+    double fragmentation () const {
+        return -1;}};
+
+// -----
+// Arena
+// -----
+
+/**
+ * an Allocator<char, N, P> or a HeapAllocator<char, P>, to replay a Trace against
+ * the footprint is Statistics::top, the bytes up to the end of the last used block
+ */
+template <typename A>
+struct Arena {
+    A& x;
+
+    explicit Arena (A& x) :
+            x (x) {}
+
+    void* allocate (std::size_t s) {
+        return x.allocate(s);}
+
+    void deallocate (void* p, std::size_t s) {
+        x.deallocate(static_cast<char*>(p), s);}
+
+    std::size_t footprint () const {
+        return x.stats().top;}
+
+    double fragmentation () const {
+        return x.stats().fragmentation();}};
+
+// ------
+// Replay
+// ------
+
+/**
+ * what replay measures
+ */
+struct Replay {
+    std::size_t         ops;
+    std::size_t         failed;        // allocates that threw bad_alloc, whose deallocates are skipped
+    double              mean;          // ns per op, from the time of a whole pass
+    double              p50;           // ns per op, from timing each op, the clock reads included
+    double              p99;
+    double              p999;
+    double              max;
+    std::size_t         peak;          // the largest footprint at any sample
+    std::vector<double> fragmentation; // at every sample
+
+    Replay () :
+            ops    (0),
+            failed (0),
+            mean   (0),
+            p50    (0),
+            p99    (0),
+            p999   (0),
+            max    (0),
+            peak   (0) {}};
+
+/**
+ * O(n) in space
+ * O(n) in time, and in the ops of s
+ * one pass of t against s, with f called after each op with the number of ops done
+ * return the number of allocates that threw
+ */
+template <typename S, typename F>
+std::size_t replay_pass (const Trace& t, S& s, F f) {
+    const std::vector<Trace::Op>& ops = t.ops();
+    std::vector<void*>             p(t.allocations());
+    std::vector<std::size_t>       n(t.allocations());
+    std::size_t                    k      = 0;
+    std::size_t                    failed = 0;
+    for (std::size_t i = 0; i != ops.size(); ++i) {
+        const Trace::Op& o = ops[i];
+        if (!o.free) {
+            try {
+                p[k] = s.allocate(o.value);}
+            catch (std::bad_alloc&) {
+                p[k] = 0;
+                ++failed;}
+            n[k++] = o.value;}
+        else if (p[o.value] != 0) {
+            s.deallocate(p[o.value], n[o.value]);
+            p[o.value] = 0;}
+        f(i + 1);}
+    for (std::size_t i = 0; i != k; ++i)
+        if (p[i] != 0)
+            s.deallocate(p[i], n[i]);
+    return failed;}
+
+/**
+ * O(n) in space
+ * O(n) in time, and in the ops of s
+ * replay t against s, a Malloc, an Arena, or anything else with allocate(bytes),
+ * deallocate(p, bytes), footprint() and fragmentation(), three times over:
+ * timed whole, timed op by op, and sampled every sample ops
+ */
+template <typename S>
+Replay replay (const Trace& t, S& s, std::size_t sample = 1000) {
+    typedef std::chrono::steady_clock clock;
+    Replay r;
+    r.ops = t.ops().size();
+    if (r.ops == 0)
+        return r;
+
+    const clock::time_point b = clock::now();
+    r.failed = replay_pass(t, s, [] (std::size_t) {});
+    r.mean   = std::chrono::duration<double, std::nano>(clock::now() - b).count() / r.ops;
+
+    std::vector<double> d;
+    d.reserve(r.ops);
+    clock::time_point   e = clock::now();
+    replay_pass(t, s, [&d, &e] (std::size_t) {
+        const clock::time_point x = clock::now();
+        d.push_back(std::chrono::duration<double, std::nano>(x - e).count());
+        e = x;});
+    std::sort(d.begin(), d.end());
+    r.p50  = d[d.size() / 2];
+    r.p99  = d[d.size() * 99 / 100];
+    r.p999 = d[d.size() * 999 / 1000];
+    r.max  = d.back();
+
+    replay_pass(t, s, [&r, &s, sample] (std::size_t i) {
+        if ((sample != 0) && (i % sample == 0)) {
+            r.peak = std::max(r.peak, s.footprint());
+            r.fragmentation.push_back(s.fragmentation());}});
+    return r;}
+
+#endif // Trace_h
@@ -0,0 +1,162 @@
+// ---------------------------------
+// projects/collatz/BenchCollatz.c++
+// ---------------------------------
+
+// https://github.com/google/benchmark
+
+// --------
+// includes
+// --------
+
+#include <cstdint> // uint64_t
+#include <random>  // mt19937_64, uniform_int_distribution
+#include <sstream> // istringstream, ostringstream
+#include <string>  // string
+#include <vector>  // vector
+
+#include "benchmark/benchmark.h"
+
+#include "Collatz.h"
+
+using namespace std;
+
+// the sizes lazy_cache starts with, see CACHE_SIZE and OVERFLOW_SIZE
+#define DENSE    1000000
+#define OVERFLOW 65536
+
+// ------------
+// cycle_length
+// ------------
+
+// no cache, from where the cache would not help much anyway
+static void BM_cycle_length (benchmark::State& state) {
+    const uint64_t b = state.range(0);
+    uint64_t       n = b;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cycle_length(n));
+        if (++n == b + 1000000)
+            n = b;}
+    state.SetItemsProcessed(state.iterations());}
+
+BENCHMARK(BM_cycle_length)->Arg(1)->Arg(1000000000000LL);
+
+// ---------------
+// lazy_cache_cold
+// ---------------
+
+// [1, n] into an empty cache, every value is a miss the first time
+static void BM_lazy_cache_cold (benchmark::State& state) {
+    const uint64_t n = state.range(0);
+    for (auto _ : state) {
+        state.PauseTiming();
+        collatz_cache_init(DENSE, OVERFLOW);
+        state.ResumeTiming();
+        for (uint64_t i = 1; i <= n; ++i)
+            benchmark::DoNotOptimize(lazy_cache(i));}
+    state.SetItemsProcessed(state.iterations() * n);}
+
+BENCHMARK(BM_lazy_cache_cold)->Arg(1 << 16)->Arg(1000000)->Unit(benchmark::kMillisecond);
+
+// ---------------
+// lazy_cache_warm
+// ---------------
+
+// [1, n] again and again, every value is a hit after the first pass
+static void BM_lazy_cache_warm (benchmark::State& state) {
+    const uint64_t n = state.range(0);
+    collatz_cache_init(DENSE, OVERFLOW);
+    for (uint64_t i = 1; i <= n; ++i)
+        lazy_cache(i);
+    for (auto _ : state)
+        for (uint64_t i = 1; i <= n; ++i)
+            benchmark::DoNotOptimize(lazy_cache(i));
+    state.SetItemsProcessed(state.iterations() * n);}
+
+BENCHMARK(BM_lazy_cache_warm)->Arg(1 << 16)->Arg(1000000)->Unit(benchmark::kMillisecond);
+
+// -------------------
+// collatz_eval_narrow
+// -------------------
+
+// many short ranges at random inside [1, 1000000)
+static void BM_collatz_eval_narrow (benchmark::State& state) {
+    const uint64_t                     n = state.range(0);
+    mt19937_64                         g(371);
+    uniform_int_distribution<uint64_t> d(1, 1000000 - n);
+    for (auto _ : state) {
+        const uint64_t i = d(g);
+        benchmark::DoNotOptimize(collatz_eval(i, i + n - 1));}
+    state.SetItemsProcessed(state.iterations() * n);}
+
+BENCHMARK(BM_collatz_eval_narrow)->Arg(10)->Arg(1000);
+
+// -----------------
+// collatz_eval_wide
+// -----------------
+
+// one range of n values starting at b
+static void BM_collatz_eval_wide (benchmark::State& state) {
+    const uint64_t b = state.range(0);
+    const uint64_t n = state.range(1);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(collatz_eval(b, b + n - 1));
+    state.SetItemsProcessed(state.iterations() * n);}
+
+BENCHMARK(BM_collatz_eval_wide)->Args({1, 1000000})->Args({1000000000000LL, 1000000})->Unit(benchmark::kMillisecond);
+
+// --------------------------
+// collatz_eval_parallel_wide
+// --------------------------
+
+static void BM_collatz_eval_parallel_wide (benchmark::State& state) {
+    const uint64_t b = state.range(0);
+    const uint64_t n = state.range(1);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(collatz_eval_parallel(b, b + n - 1));
+    state.SetItemsProcessed(state.iterations() * n);}
+
+BENCHMARK(BM_collatz_eval_parallel_wide)->Args({1000000000000LL, 10000000})->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// -------------
+// collatz_solve
+// -------------
+
+// n lines of short random ranges, end to end through the string streams
+static void BM_collatz_solve (benchmark::State& state) {
+    const int                          n = state.range(0);
+    mt19937_64                         g(371);
+    uniform_int_distribution<uint64_t> d(1, 999000);
+    ostringstream                      s;
+    for (int k = 0; k != n; ++k) {
+        const uint64_t i = d(g);
+        s << i << " " << i + g() % 1000 << "\n";}
+    const string in = s.str();
+    for (auto _ : state) {
+        istringstream r(in);
+        ostringstream w;
+        collatz_solve(r, w);
+        benchmark::DoNotOptimize(w.str().size());}
+    state.SetItemsProcessed(state.iterations() * n);
+    state.SetBytesProcessed(state.iterations() * in.size());}
+
+BENCHMARK(BM_collatz_solve)->Arg(1000)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
+
+/*
+% g++ -pedantic -std=c++11 -Wall -O3 Collatz.c++ BenchCollatz.c++ -o BenchCollatz -lbenchmark -pthread
+
+
+
+% ./BenchCollatz --benchmark_out=BenchCollatz.json --benchmark_out_format=json
+
+
+
+% benchmark/tools/compare.py benchmarks BenchCollatz.base.json BenchCollatz.json
+
+
+
+a baseline only means something on the machine it is compared on, so none is
+checked in: on a quiet machine with cpu scaling off and a release build of
+the benchmark library, run make baseline before the change and make bench after
+*/
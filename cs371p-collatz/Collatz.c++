@@ -8,94 +8,858 @@
 // includes
 // --------
 
-#include <cassert>  // assert
-#include <iostream> // endl, istream, ostream
-#include <sstream>  // istringstream
-#include <string>   // getline, string
-#include <utility>  // make_pair, pair
+#include <algorithm>          // copy, max, max_element, min
+#include <atomic>             // atomic, memory_order_relaxed
+#include <cassert>            // assert
+#include <condition_variable> // condition_variable
+#include <cstddef>            // size_t
+#include <cstdint>            // uint16_t, uint32_t, uint64_t
+#include <cstring>            // memchr, memcmp, memcpy, memmove, memset
+#include <fstream>            // ifstream, ofstream
+#include <functional>         // function
+#include <iostream>           // endl, istream, ostream, streambuf, streamsize
+#include <memory>             // unique_ptr
+#include <mutex>              // lock_guard, mutex, unique_lock
+#include <sstream>            // istringstream
+#include <stdexcept>          // overflow_error, runtime_error
+#include <string>             // getline, string
+#include <thread>             // thread
+#include <utility>            // make_pair, pair, swap
+#include <vector>             // vector
+
+#include <fcntl.h>    // open, O_RDONLY
+#include <sys/mman.h> // mmap, munmap
+#include <sys/stat.h> // fstat
+#include <unistd.h>   // close
 
 #include "Collatz.h"
 
-#define CACHE_SIZE 1000000
+#define CACHE_SIZE    1000000
+#define STEP_BITS     16
+#define OVERFLOW_SIZE 65536
+#define SHARDS        64
+#define PROBES        16
+#define PATH_SIZE     1024
+#define CHUNK_SIZE    8192
+#define BLOCK_SIZE    64
+#define BATCH_SIZE    1024
+#define IO_SIZE       65536
+
+#ifdef COLLATZ_SIMD
+#include <immintrin.h> // AVX2 and AVX-512 intrinsics
+#endif
 using namespace std;
 
 // ------------
 // collatz_read
 // ------------
 
-pair<int, int> collatz_read (const string& s) {
+pair<uint64_t, uint64_t> collatz_read (const string& s) {
 	istringstream sin(s);
-	int i;
-	int j;
+	uint64_t i;
+	uint64_t j;
 	sin >> i >> j;
 	return make_pair(i, j);}
 
+// -----
+// limit
+// -----
+
+/**
+ * the largest odd n whose step n + (n >> 1) + 1 still fits in U
+ * checking it costs one well-predicted compare per odd step
+ */
+template <typename U>
+U limit () {
+    return (~U(0) - 1) / 3 * 2;}
+
+#ifdef STEP_BITS
+
+// ------------
+// CollatzSteps
+// ------------
+
+/**
+ * tables for taking STEP_BITS steps at once, STEP_BITS at most 20
+ * write n = a * 2^k + b with b the low k bits, then the next k steps depend
+ * on b alone: with odd[b] of them odd they take n to a * 3^odd[b] + add[b]
+ * and add k + odd[b] to the cycle length
+ * when n >= 2^k no step inside the block can reach 1, since each step at
+ * most halves n; below 2^k length holds the whole cycle length instead
+ */
+struct CollatzSteps {
+    uint8_t  odd[1 << STEP_BITS];
+    uint32_t add[1 << STEP_BITS];
+    uint16_t length[1 << STEP_BITS];
+    uint64_t power[STEP_BITS + 1];
+    int      carry;
+
+    CollatzSteps () {
+        power[0] = 1;
+        for (int o = 1; o <= STEP_BITS; ++o)
+            power[o] = 3 * power[o - 1];
+        // a * 3^o + d fits in w bits whenever a < 2^(w - carry)
+        carry = 1;
+        while ((power[STEP_BITS] >> carry) != 0)
+            ++carry;
+        ++carry;
+
+        for (uint32_t b = 0; b < (1U << STEP_BITS); ++b) {
+            uint64_t d = b;
+            int      o = 0;
+            for (int j = 0; j < STEP_BITS; ++j) {
+                if ((d % 2) == 0)
+                    d >>= 1;
+                else {
+                    d = d + (d >> 1) + 1;
+                    ++o;}}
+            odd[b] = static_cast<uint8_t>(o);
+            add[b] = static_cast<uint32_t>(d);}
+
+        length[0] = 0;
+        length[1] = 1;
+        for (uint32_t k = 2; k < (1U << STEP_BITS); ++k) {
+            uint64_t n = k;
+            int      c = 0;
+            while (n >= k) {
+                if ((n % 2) == 0) {
+                    n >>= 1;
+                    ++c;
+                  } else {
+                    n = n + (n >> 1) + 1;
+                    ++++c;
+                  }}
+            length[k] = static_cast<uint16_t>(c + length[n]);}}};
+
+/**
+ * the step tables, built on first use
+ */
+const CollatzSteps& collatz_steps () {
+    static const CollatzSteps steps;
+    return steps;}
+
+#endif
+
+// ------------
+// collatz_step
+// ------------
+
+/**
+ * advance n, which is at least 2, along its trajectory
+ * with STEP_BITS that is a whole block of steps when n is at least 2^k and
+ * the block cannot overflow U, otherwise it is a single step
+ * @return the number of steps taken, 0, leaving n alone, if the step would overflow U
+ */
+template <typename U>
+inline int collatz_step (U& n) {
+		#ifdef STEP_BITS
+    const CollatzSteps& t = collatz_steps();
+    const U             a = n >> STEP_BITS;
+    if ((a != 0) && ((a >> (sizeof(U) * 8 - t.carry)) == 0)) {
+        const size_t b = static_cast<size_t>(n) & ((1U << STEP_BITS) - 1);
+        n = static_cast<U>(a * t.power[t.odd[b]] + t.add[b]);
+        return STEP_BITS + t.odd[b];}
+		#endif
+    if ((n % 2) == 0) {
+        n >>= 1;
+        return 1;}
+    if (n > limit<U>())
+        return 0;
+    n = n + (n >> 1) + 1;
+    return 2;}
+
+// ------------
+// collatz_tail
+// ------------
+
+/**
+ * @return the cycle length of n if a table holds it, 0 otherwise
+ */
+template <typename U>
+inline int collatz_tail (U n) {
+		#ifdef STEP_BITS
+    if ((n >> STEP_BITS) == 0)
+        return collatz_steps().length[static_cast<size_t>(n)];
+		#endif
+    return (n == 1) ? 1 : 0;}
+
 //-----------------------
 // calculate cycle length
 //-----------------------
 
-int cycle_length (int n) {
+template <typename U>
+int cycle_length (typename CollatzWidth<U>::type n);
+
+#ifdef __SIZEOF_INT128__
+__extension__ typedef unsigned __int128 uint128;
+
+/**
+ * finish a trajectory that outgrew its width in 128 bits
+ */
+int cycle_length_wide (uint128 n) {
+    return cycle_length<uint128>(n);}
+#else
+int cycle_length_wide (uint64_t) {
+    throw overflow_error("collatz: trajectory overflows 64 bits");}
+#endif
+
+template <typename U>
+int cycle_length (typename CollatzWidth<U>::type n) {
     assert(n > 0);
-    int c = 1;
-    while (n > 1) {
-        if ((n % 2) == 0) {
-            n >>= 1;
-            ++c;
-          } else {
-            n = n + (n >> 1) + 1;
-            ++++c;
-          }
+    int c = 0;
+    int h;
+    while ((h = collatz_tail(n)) == 0) {
+        const int s = collatz_step(n);
+        if (s == 0) {
+            if (sizeof(U) >= 16)
+                throw overflow_error("collatz: trajectory overflows 128 bits");
+            h = cycle_length_wide(n);
+            break;}
+        c += s;
       }
 
-    assert(c > 0);
-    return c;}
+    assert(c + h > 0);
+    return c + h;}
+
+template int cycle_length<uint32_t> (uint32_t);
+template int cycle_length<uint64_t> (uint64_t);
+
+#ifdef CACHE_SIZE
+
+// ------------
+// CollatzCache
+// ------------
+
+/**
+ * cycle lengths shared by every thread that calls lazy_cache
+ * values below the dense size index an array of atomics directly
+ * larger values go to the overflow tier, SHARDS open-addressing tables
+ * whose slots pack (n << 16) | length into one atomic word
+ * reads and fills are relaxed atomic operations, there are no locks:
+ * two threads filling the same entry always write the same value
+ */
+class CollatzCache {
+    private:
+        typedef unsigned long long word;
+
+        size_t                    _dense;
+        size_t                    _shard;
+        unique_ptr<atomic<int>[]> _array;
+        unique_ptr<atomic<word>[]> _table;
+
+        /**
+         * first slot of n's probe sequence
+         * the high bits of the hash pick the shard, the low bits the slot
+         */
+        size_t home (word n) const {
+            const word h = n * 0x9E3779B97F4A7C15ULL;
+            return (h >> 58) % SHARDS * _shard + (h & (_shard - 1));}
+
+    public:
+        typedef unsigned long long value_type;
+
+        /**
+         * @param dense    the number of values, [0, dense), in the dense tier
+         * @param overflow the number of slots in the overflow tier
+         */
+        CollatzCache (size_t dense, size_t overflow) {
+            resize(dense, overflow);}
+
+        /**
+         * drop every entry and reallocate both tiers
+         * not safe while another thread is using the cache
+         */
+        void resize (size_t dense, size_t overflow) {
+            _shard = 1;
+            while (_shard * SHARDS < overflow)
+                _shard <<= 1;
+            _dense = dense;
+            _array.reset(new atomic<int>[dense]());
+            _table.reset(new atomic<word>[_shard * SHARDS]());}
+
+        /**
+         * @return the number of values in the dense tier
+         */
+        size_t dense () const {
+            return _dense;}
+
+        /**
+         * @return the cached cycle length of n, 0 if there is none
+         */
+        int get (word n) const {
+            if (n < _dense)
+                return _array[n].load(memory_order_relaxed);
+            if ((n >> 48) != 0)
+                return 0;
+            const size_t b = home(n);
+            const size_t s = b - b % _shard;
+            for (size_t p = 0; p < PROBES; ++p) {
+                const word e = _table[s + (b + p) % _shard].load(memory_order_relaxed);
+                if (e == 0)
+                    return 0;
+                if ((e >> 16) == n)
+                    return static_cast<int>(e & 0xFFFF);}
+            return 0;}
+
+        /**
+         * record the cycle length v of n
+         * an overflow entry is dropped when its probe sequence is full
+         */
+        void put (word n, int v) {
+            assert(v > 0);
+            if (n < _dense) {
+                _array[n].store(v, memory_order_relaxed);
+                return;}
+            if (((n >> 48) != 0) || (v > 0xFFFF))
+                return;
+            const word   e = (n << 16) | static_cast<word>(v);
+            const size_t b = home(n);
+            const size_t s = b - b % _shard;
+            for (size_t p = 0; p < PROBES; ++p) {
+                atomic<word>& slot = _table[s + (b + p) % _shard];
+                word          x    = 0;
+                if (slot.compare_exchange_strong(x, e, memory_order_relaxed) || ((x >> 16) == n))
+                    return;}}};
+
+// -------------
+// collatz_cache
+// -------------
+
+/**
+ * the cache behind lazy_cache, built on first use
+ */
+CollatzCache& collatz_cache () {
+    static CollatzCache cache(CACHE_SIZE, OVERFLOW_SIZE);
+    return cache;}
+
+#endif
+
+// ------------------
+// collatz_cache_init
+// ------------------
+
+void collatz_cache_init (size_t dense, size_t overflow) {
+		#ifdef CACHE_SIZE
+    collatz_cache().resize(dense, overflow);
+		#endif
+}
 
 // ------------
 // lazy_cache
 // -----------
 
-int lazy_cache(unsigned int i){
+template <typename U>
+int lazy_cache(typename CollatzWidth<U>::type i){
 		#ifdef CACHE_SIZE
-		
+
     assert (i > 0);
-    static int Cache[CACHE_SIZE] = {};
-    assert (i < CACHE_SIZE);
-    if (Cache[i] == 0){
-        Cache[i] = cycle_length(i);
+    CollatzCache& cache = collatz_cache();
+    int v = cache.get(i);
+    if (v != 0)
+        return v;
+
+    // walk the trajectory until it reaches a value the step tables or the
+    // dense tier already know, remembering each dense value on the way and
+    // how many steps in it was
+    typedef CollatzCache::value_type value_type;
+    const value_type dense = cache.dense();
+    value_type       path[PATH_SIZE];
+    int              step[PATH_SIZE];
+    size_t           k = 0;
+    U                n = i;
+    int              c = 0;
+    int              h;
+    while ((h = collatz_tail(n)) == 0) {
+        if ((n < dense) && (c != 0) && ((h = cache.get(n)) != 0))
+            break;
+        if ((n < dense) && (k < PATH_SIZE)) {
+            path[k] = n;
+            step[k] = c;
+            ++k;
+        }
+        const int s = collatz_step(n);
+        if (s == 0) {
+            h = cycle_length_wide(n);
+            break;
+        }
+        c += s;
     }
-    return Cache[i];
+
+    // unwind, every remembered value is (c - step) further from 1 than n
+    v = c + h;
+    while (k != 0) {
+        --k;
+        cache.put(path[k], v - step[k]);
+    }
+    cache.put(i, v);
+    assert(v > 0);
+    return v;
 
 		#endif
 
 		#ifndef CACHE_SIZE
 
-		return cycle_length(i);
+		return cycle_length<U>(i);
 
 		#endif
 }
 
+template int lazy_cache<uint32_t> (uint32_t);
+template int lazy_cache<uint64_t> (uint64_t);
+
+// -------------
+// batch kernels
+// -------------
+
+// stopping at 2^62 means an odd step never overflows a lane, and every
+// value stays below 2^63, where signed and unsigned compares agree
+const uint64_t COLLATZ_LANE_CAP = 1ULL << 62;
+
+void collatz_kernel_scalar (uint64_t* n, int* c, size_t count, uint64_t floor) {
+    for (size_t k = 0; k < count; ++k) {
+        uint64_t v = n[k];
+        int      s = 0;
+        while ((v >= floor) && (v < COLLATZ_LANE_CAP))
+            s += collatz_step(v);
+        n[k] = v;
+        c[k] = s;}}
+
+#ifdef COLLATZ_SIMD
+
+/**
+ * eight values at a time in two ymm registers of four lanes
+ * a lane that has dropped below floor stops changing while the rest run on
+ */
+__attribute__((target("avx2")))
+void collatz_kernel_avx2 (uint64_t* n, int* c, size_t count, uint64_t floor) {
+    const __m256i one = _mm256_set1_epi64x(1);
+    const __m256i low = _mm256_set1_epi64x(floor - 1);
+    const __m256i cap = _mm256_set1_epi64x(COLLATZ_LANE_CAP);
+    const size_t  m   = count - count % 8;
+    for (size_t k = 0; k < m; k += 8) {
+        __m256i v[2] = {_mm256_loadu_si256(reinterpret_cast<const __m256i*>(n + k)),
+                        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(n + k + 4))};
+        __m256i s[2] = {_mm256_setzero_si256(), _mm256_setzero_si256()};
+        for (;;) {
+            const __m256i a0 = _mm256_and_si256(_mm256_cmpgt_epi64(v[0], low), _mm256_cmpgt_epi64(cap, v[0]));
+            const __m256i a1 = _mm256_and_si256(_mm256_cmpgt_epi64(v[1], low), _mm256_cmpgt_epi64(cap, v[1]));
+            if (_mm256_testz_si256(_mm256_or_si256(a0, a1), _mm256_or_si256(a0, a1)))
+                break;
+            const __m256i a[2] = {a0, a1};
+            for (int r = 0; r < 2; ++r) {
+                const __m256i odd  = _mm256_and_si256(v[r], one);
+                const __m256i half = _mm256_srli_epi64(v[r], 1);
+                const __m256i grow = _mm256_add_epi64(_mm256_add_epi64(v[r], half), one);
+                const __m256i next = _mm256_blendv_epi8(half, grow, _mm256_sub_epi64(_mm256_setzero_si256(), odd));
+                v[r] = _mm256_blendv_epi8(v[r], next, a[r]);
+                s[r] = _mm256_add_epi64(s[r], _mm256_and_si256(a[r], _mm256_add_epi64(one, odd)));}}
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(n + k),     v[0]);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(n + k + 4), v[1]);
+        for (int r = 0; r < 2; ++r) {
+            uint64_t t[4];
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(t), s[r]);
+            for (int l = 0; l < 4; ++l)
+                c[k + 4 * r + l] = static_cast<int>(t[l]);}}
+    collatz_kernel_scalar(n + m, c + m, count - m, floor);}
+
+/**
+ * sixteen values at a time in two zmm registers of eight lanes
+ * mask registers say which lanes are still above floor and which are odd
+ */
+__attribute__((target("avx512f")))
+void collatz_kernel_avx512 (uint64_t* n, int* c, size_t count, uint64_t floor) {
+    const __m512i one = _mm512_set1_epi64(1);
+    const __m512i low = _mm512_set1_epi64(floor);
+    const __m512i cap = _mm512_set1_epi64(COLLATZ_LANE_CAP);
+    const size_t  m   = count - count % 16;
+    for (size_t k = 0; k < m; k += 16) {
+        __m512i v[2] = {_mm512_loadu_si512(n + k), _mm512_loadu_si512(n + k + 8)};
+        __m512i s[2] = {_mm512_setzero_si512(), _mm512_setzero_si512()};
+        for (;;) {
+            const __mmask8 a[2] = {
+                static_cast<__mmask8>(_mm512_cmpge_epu64_mask(v[0], low) & _mm512_cmplt_epu64_mask(v[0], cap)),
+                static_cast<__mmask8>(_mm512_cmpge_epu64_mask(v[1], low) & _mm512_cmplt_epu64_mask(v[1], cap))};
+            if ((a[0] | a[1]) == 0)
+                break;
+            for (int r = 0; r < 2; ++r) {
+                // the maskz forms, since the plain ones start from an
+                // undefined vector that gcc warns may be used uninitialised
+                const __mmask8 odd  = _mm512_test_epi64_mask(v[r], one);
+                const __m512i  half = _mm512_maskz_srli_epi64(0xFF, v[r], 1);
+                const __m512i  grow = _mm512_add_epi64(_mm512_add_epi64(v[r], half), one);
+                v[r] = _mm512_mask_mov_epi64(v[r], a[r], _mm512_mask_mov_epi64(half, odd, grow));
+                s[r] = _mm512_mask_add_epi64(s[r], a[r], s[r], one);
+                s[r] = _mm512_mask_add_epi64(s[r], a[r] & odd, s[r], one);}}
+        _mm512_storeu_si512(n + k,     v[0]);
+        _mm512_storeu_si512(n + k + 8, v[1]);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(c + k),     _mm512_maskz_cvtepi64_epi32(0xFF, s[0]));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(c + k + 8), _mm512_maskz_cvtepi64_epi32(0xFF, s[1]));}
+    collatz_kernel_scalar(n + m, c + m, count - m, floor);}
+
+#endif
+
+/**
+ * the widest kernel this CPU runs, picked once
+ */
+collatz_kernel collatz_dispatch () {
+	#ifdef COLLATZ_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return collatz_kernel_avx512;
+    if (__builtin_cpu_supports("avx2"))
+        return collatz_kernel_avx2;
+	#endif
+    return collatz_kernel_scalar;}
+
+// ------------------
+// cycle_length_batch
+// ------------------
+
+void cycle_length_batch (uint64_t first, size_t count, int* out) {
+    assert(first > 0);
+    static const collatz_kernel kernel = collatz_dispatch();
+
+    // the lanes only run until they fall into the dense tier (or below first,
+    // whichever is lower), lazy_cache finishes each trajectory from there
+    // and also takes over any lane that climbed past the lane cap
+    uint64_t dense = 0;
+		#ifdef CACHE_SIZE
+    dense = collatz_cache().dense();
+		#endif
+    const uint64_t floor = std::max<uint64_t>(2, std::min(first, dense));
+
+    uint64_t n[BATCH_SIZE];
+    int      c[BATCH_SIZE];
+    while (count != 0) {
+        const size_t m = std::min<size_t>(count, BATCH_SIZE);
+        if (first + m > COLLATZ_LANE_CAP) {
+            for (size_t k = 0; k < m; ++k)
+                out[k] = lazy_cache(first + k);}
+        else {
+            for (size_t k = 0; k < m; ++k)
+                n[k] = first + k;
+            kernel(n, c, m, floor);
+            for (size_t k = 0; k < m; ++k)
+                out[k] = c[k] + lazy_cache(n[k]);}
+        first += m;
+        out   += m;
+        count -= m;}}
+
+// ------------
+// CollatzIndex
+// ------------
+
+/**
+ * range-maximum index over the cycle lengths of [1, bound]
+ * the lengths are split into BLOCK_SIZE blocks and a sparse table holds,
+ * for every level l and block b, the max of blocks [b, b + 2^l)
+ * a query scans at most two partial blocks and reads two table entries
+ * the file format is the header followed by the lengths and every level,
+ * exactly as they sit in memory, so a file can be mapped and used in place
+ */
+class CollatzIndex {
+    private:
+        struct Header {
+            char     magic[8];
+            uint32_t version;
+            uint32_t block;
+            uint64_t bound;
+            uint64_t levels;};
+
+        uint64_t                _bound;
+        vector<uint16_t>        _store;
+        void*                   _map;
+        size_t                  _size;
+        const uint16_t*         _length;
+        vector<const uint16_t*> _table;
+
+        static Header header (uint64_t bound) {
+            Header h;
+            memset(&h, 0, sizeof(h));
+            memcpy(h.magic, "CLZINDEX", 8);
+            h.version = 2;
+            h.block   = BLOCK_SIZE;
+            h.bound   = bound;
+            h.levels  = 1;
+            while ((2ULL << (h.levels - 1)) <= bound / BLOCK_SIZE + 1)
+                ++h.levels;
+            return h;}
+
+        /**
+         * @return the number of uint16_t after the header
+         */
+        static uint64_t words (const Header& h) {
+            const uint64_t n = h.bound / BLOCK_SIZE + 1;
+            uint64_t       w = h.bound + 1;
+            for (uint64_t l = 0; l < h.levels; ++l)
+                w += n - (1ULL << l) + 1;
+            return w;}
+
+        /**
+         * check h against what this build writes
+         * @throw runtime_error if it is not an index or size bytes cannot hold it
+         */
+        static void check (const Header& h, uint64_t size, const string& path) {
+            const Header x = header(h.bound);
+            if ((memcmp(h.magic, x.magic, 8) != 0) || (h.version != x.version) || (h.block != x.block) ||
+                (h.bound == 0) || (h.levels != x.levels))
+                throw runtime_error("collatz: " + path + " is not a cycle-length index");
+            if ((size < sizeof(h)) || ((size - sizeof(h)) / sizeof(uint16_t) < words(h)))
+                throw runtime_error("collatz: " + path + " is truncated");}
+
+        /**
+         * point _length and _table into p, laid out as in the file
+         */
+        void point (const uint16_t* p) {
+            const Header   h = header(_bound);
+            const uint64_t n = _bound / BLOCK_SIZE + 1;
+            _length = p;
+            p += _bound + 1;
+            _table.clear();
+            for (uint64_t l = 0; l < h.levels; ++l) {
+                _table.push_back(p);
+                p += n - (1ULL << l) + 1;}}
+
+        /**
+         * max of the whole blocks [b, e]
+         */
+        int blocks (uint64_t b, uint64_t e) const {
+            uint64_t l = 0;
+            while ((2ULL << l) <= e - b + 1)
+                ++l;
+            return std::max(_table[l][b], _table[l][e - (1ULL << l) + 1]);}
+
+        /**
+         * max of the lengths [b, e], all inside one block
+         */
+        int scan (uint64_t b, uint64_t e) const {
+            int max = 1;
+            while (b <= e)
+                max = std::max(max, static_cast<int>(_length[b++]));
+            return max;}
+
+        CollatzIndex (const CollatzIndex&);
+        CollatzIndex& operator = (const CollatzIndex&);
+
+    public:
+        /**
+         * compute the cycle length of every value in [1, bound], then the table
+         * each trajectory only runs until it drops below its starting value
+         */
+        explicit CollatzIndex (uint64_t bound) :
+                _bound  (bound),
+                _store  (words(header(bound)), 1),
+                _map    (nullptr),
+                _size   (0) {
+            assert(bound > 0);
+            point(_store.data());
+            uint16_t* length = _store.data();
+            for (uint64_t k = 2; k <= bound; ++k) {
+                uint64_t n = k;
+                int      c = 0;
+                while (n >= k) {
+                    if ((n % 2) == 0) {
+                        n >>= 1;
+                        ++c;
+                      } else {
+                        n = n + (n >> 1) + 1;
+                        ++++c;
+                      }}
+                length[k] = static_cast<uint16_t>(c + length[n]);}
+
+            const uint64_t n     = bound / BLOCK_SIZE + 1;
+            uint16_t*      level = length + bound + 1;
+            for (uint64_t k = 0; k <= bound; ++k)
+                level[k / BLOCK_SIZE] = std::max(level[k / BLOCK_SIZE], length[k]);
+            for (uint64_t l = 1; l < _table.size(); ++l) {
+                const uint16_t* p = level;
+                level += n - (1ULL << (l - 1)) + 1;
+                for (uint64_t b = 0; b < n - (1ULL << l) + 1; ++b)
+                    level[b] = std::max(p[b], p[b + (1ULL << (l - 1))]);}}
+
+        /**
+         * read an index written by save into memory
+         * if map is true, map the file read-only instead, so processes that
+         * use the same file share one copy of it in the page cache
+         * @throw runtime_error if the file is missing, truncated or not an index
+         */
+        CollatzIndex (const string& path, bool map) :
+                _bound  (0),
+                _map    (nullptr),
+                _size   (0) {
+            Header h;
+            if (map) {
+                const int fd = open(path.c_str(), O_RDONLY);
+                struct stat st;
+                if ((fd == -1) || (fstat(fd, &st) == -1) || (static_cast<size_t>(st.st_size) < sizeof(h))) {
+                    if (fd != -1)
+                        close(fd);
+                    throw runtime_error("collatz: " + path + " is not a cycle-length index");}
+                _size = st.st_size;
+                _map  = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+                close(fd);
+                if (_map == MAP_FAILED) {
+                    _map = nullptr;
+                    throw runtime_error("collatz: cannot map " + path);}
+                memcpy(&h, _map, sizeof(h));
+                try {
+                    check(h, _size, path);}
+                catch (...) {
+                    munmap(_map, _size);
+                    throw;}
+                _bound = h.bound;
+                point(reinterpret_cast<const uint16_t*>(static_cast<const char*>(_map) + sizeof(h)));}
+            else {
+                ifstream in(path.c_str(), ios::binary | ios::ate);
+                const uint64_t size = in ? static_cast<uint64_t>(in.tellg()) : 0;
+                in.seekg(0);
+                if (!in.read(reinterpret_cast<char*>(&h), sizeof(h)))
+                    throw runtime_error("collatz: " + path + " is not a cycle-length index");
+                check(h, size, path);
+                _bound = h.bound;
+                _store.resize(words(h));
+                in.read(reinterpret_cast<char*>(_store.data()), _store.size() * sizeof(uint16_t));
+                point(_store.data());}}
+
+        ~CollatzIndex () {
+            if (_map != nullptr)
+                munmap(_map, _size);}
+
+        /**
+         * write the header, the lengths and every level of the table
+         * @return false if the file could not be written
+         */
+        bool save (const string& path) const {
+            const Header h = header(_bound);
+            ofstream out(path.c_str(), ios::binary | ios::trunc);
+            out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+            out.write(reinterpret_cast<const char*>(_length), words(h) * sizeof(uint16_t));
+            return static_cast<bool>(out.flush());}
+
+        uint64_t bound () const {
+            return _bound;}
+
+        /**
+         * @return the max cycle length of [i, j], i <= j <= bound
+         */
+        int query (uint64_t i, uint64_t j) const {
+            assert((0 < i) && (i <= j) && (j <= _bound));
+            const uint64_t bi = i / BLOCK_SIZE;
+            const uint64_t bj = j / BLOCK_SIZE;
+            if (bi == bj)
+                return scan(i, j);
+            int max = std::max(scan(i, bi * BLOCK_SIZE + BLOCK_SIZE - 1), scan(bj * BLOCK_SIZE, j));
+            if (bj - bi > 1)
+                max = std::max(max, blocks(bi + 1, bj - 1));
+            return max;}};
+
+// -------------
+// collatz_index
+// -------------
+
+/**
+ * the index collatz_eval consults, null until one is built or loaded
+ */
+unique_ptr<CollatzIndex>& collatz_index () {
+    static unique_ptr<CollatzIndex> index;
+    return index;}
+
+// -------------------
+// collatz_index_build
+// -------------------
+
+void collatz_index_build (unsigned int bound) {
+    collatz_index().reset(new CollatzIndex(bound));}
+
+// ------------------
+// collatz_index_load
+// ------------------
+
+bool collatz_index_load (const string& path) {
+    try {
+        collatz_index().reset(new CollatzIndex(path, false));}
+    catch (const runtime_error&) {
+        return false;}
+    return true;}
+
+// -----------------
+// collatz_index_map
+// -----------------
+
+bool collatz_index_map (const string& path) {
+    try {
+        collatz_index().reset(new CollatzIndex(path, true));}
+    catch (const runtime_error&) {
+        return false;}
+    return true;}
+
+// ------------------
+// collatz_index_save
+// ------------------
+
+bool collatz_index_save (const string& path) {
+    return collatz_index() && collatz_index()->save(path);}
+
+// -------------------
+// collatz_index_clear
+// -------------------
+
+void collatz_index_clear () {
+    collatz_index().reset();}
+
+// ------------
+// collatz_scan
+// ------------
+
+/**
+ * the max cycle length of [i, j] without the index
+ * values in the dense tier go through lazy_cache one at a time, colder
+ * values run through cycle_length_batch BATCH_SIZE at a time
+ */
+template <typename U>
+int collatz_scan (U i, U j) {
+    assert((0 < i) && (i <= j));
+    uint64_t dense = 0;
+		#ifdef CACHE_SIZE
+    dense = collatz_cache().dense();
+		#endif
+    int max = 1;
+    for (;;) {
+        if (i < dense) {
+            max = std::max(max, lazy_cache<U>(i));
+            if (i == j)
+                break;
+            ++i;}
+        else {
+            int          out[BATCH_SIZE];
+            const size_t m = (j - i < BATCH_SIZE) ? static_cast<size_t>(j - i) + 1 : BATCH_SIZE;
+            cycle_length_batch(i, m, out);
+            max = std::max(max, *max_element(out, out + m));
+            if (j - i < m)
+                break;
+            i += m;}}
+    return max;}
+
 // ------------
 // collatz_eval
 // ------------
 
-int collatz_eval (int i, int j) {
+template <typename U>
+int collatz_eval (typename CollatzWidth<U>::type i, typename CollatzWidth<U>::type j) {
     assert(i > 0);
     assert(j > 0);
 
     if (i > j){
-        int temp = j;
+        U temp = j;
         j = i;
         i = temp;
     }
 
-    int max = 1;
-    while (i <= j) {
-        int tempLength = lazy_cache(i);
-        if (max < tempLength) {
-            max = tempLength;
-        }
-        ++i;
-    }
+    const CollatzIndex* index = collatz_index().get();
+    if ((index != nullptr) && (j <= index->bound()))
+        return index->query(i, j);
+
+    const int max = collatz_scan(i, j);
 		// int cli = 0;
 		// int clj = 0;
 		// int max = 1;
@@ -110,22 +874,218 @@ int collatz_eval (int i, int j) {
 		assert (max > 0);
     return max;}
 
+template int collatz_eval<uint32_t> (uint32_t, uint32_t);
+template int collatz_eval<uint64_t> (uint64_t, uint64_t);
+
+// -----------
+// CollatzPool
+// -----------
+
+/**
+ * worker threads that live as long as the program, started the first time
+ * they are needed, so that collatz_eval_parallel pays for a wake-up rather
+ * than a thread per worker on every call
+ * one job runs at a time, callers from other threads wait their turn
+ */
+class CollatzPool {
+    private:
+        mutex                   _busy;       // held for the whole of a run
+        mutex                   _lock;       // guards everything below
+        condition_variable      _wake;
+        condition_variable      _done;
+        vector<thread>          _workers;
+        function<void (size_t)> _job;
+        size_t                  _generation;
+        size_t                  _wanted;     // workers 1 through _wanted - 1 run _job
+        size_t                  _running;    // of them, those not done yet
+        bool                    _stop;
+
+        /**
+         * run _job(k) once per generation that wants worker k, until _stop
+         */
+        void work (size_t k) {
+            size_t             seen = 0;
+            unique_lock<mutex> g(_lock);
+            for (;;) {
+                _wake.wait(g, [this, seen] {return _stop || (_generation != seen);});
+                if (_stop)
+                    return;
+                seen = _generation;
+                if (k >= _wanted)
+                    continue;
+                g.unlock();
+                _job(k);
+                g.lock();
+                if (--_running == 0)
+                    _done.notify_one();}}
+
+    public:
+        CollatzPool () :
+                _generation (0),
+                _wanted     (0),
+                _running    (0),
+                _stop       (false) {}
+
+        CollatzPool             (const CollatzPool&) = delete;
+        CollatzPool& operator = (const CollatzPool&) = delete;
+
+        ~CollatzPool () {
+            {
+                lock_guard<mutex> g(_lock);
+                _stop = true;}
+            _wake.notify_all();
+            for (thread& t : _workers)
+                t.join();}
+
+        /**
+         * call f(k) for every k in [0, threads), f(0) on the calling thread,
+         * and return when they have all returned
+         */
+        void run (size_t threads, const function<void (size_t)>& f) {
+            lock_guard<mutex> serial(_busy);
+            {
+                lock_guard<mutex> g(_lock);
+                while (_workers.size() + 1 < threads)
+                    _workers.push_back(thread(&CollatzPool::work, this, _workers.size() + 1));
+                _job     = f;
+                _wanted  = threads;
+                _running = threads - 1;
+                ++_generation;}
+            _wake.notify_all();
+            f(0);
+            unique_lock<mutex> g(_lock);
+            _done.wait(g, [this] {return _running == 0;});}};
+
+CollatzPool& collatz_pool () {
+    static CollatzPool pool;
+    return pool;}
+
+// ---------------------
+// collatz_eval_parallel
+// ---------------------
+
+template <typename U>
+int collatz_eval_parallel (typename CollatzWidth<U>::type i, typename CollatzWidth<U>::type j, unsigned int threads) {
+    assert(i > 0);
+    assert(j > 0);
+
+    if (i > j)
+        swap(i, j);
+    if (threads == 0)
+        threads = thread::hardware_concurrency();
+
+    const CollatzIndex* index  = collatz_index().get();
+    const U             chunks = (j - i) / CHUNK_SIZE + 1;
+    if ((threads <= 1) || (chunks < 2) || ((index != nullptr) && (j <= index->bound())))
+        return collatz_eval<U>(i, j);
+    if (threads > chunks)
+        threads = static_cast<unsigned int>(chunks);
+
+    // no chunk makes more work, so a shared counter is all the balancing
+    // needed: a worker that is done with one chunk takes the next nobody has
+    atomic<U>   next(0);
+    vector<int> results(threads, 1);
+    collatz_pool().run(threads, [&] (size_t k) {
+        int max = 1;
+        for (U c = next.fetch_add(1, memory_order_relaxed); c < chunks; c = next.fetch_add(1, memory_order_relaxed)) {
+            const U b = i + c * CHUNK_SIZE;
+            const U e = (c == chunks - 1) ? j : b + CHUNK_SIZE - 1;
+            max = std::max(max, collatz_scan(b, e));}
+        results[k] = max;});
+
+    const int max = *max_element(results.begin(), results.end());
+    assert(max > 0);
+    return max;}
+
+template int collatz_eval_parallel<uint32_t> (uint32_t, uint32_t, unsigned int);
+template int collatz_eval_parallel<uint64_t> (uint64_t, uint64_t, unsigned int);
+
 // -------------
 // collatz_print
 // -------------
 
-void collatz_print (ostream& w, int i, int j, int v) {
+void collatz_print (ostream& w, uint64_t i, uint64_t j, int v) {
 	w << i << " " << j << " " << v << endl;}
 
+// -------------
+// collatz_parse
+// -------------
+
+/**
+ * read an unsigned int out of [b, e) the way operator>> would, skipping
+ * leading whitespace
+ * @param b advanced past the int
+ * @return false if [b, e) holds no int
+ */
+bool collatz_parse (const char*& b, const char* e, uint64_t& n) {
+	while ((b != e) && ((*b == ' ') || (*b == '\t') || (*b == '\r') || (*b == '\v') || (*b == '\f')))
+		++b;
+	if ((b == e) || (static_cast<unsigned char>(*b - '0') > 9))
+		return false;
+	n = 0;
+	while ((b != e) && (static_cast<unsigned char>(*b - '0') <= 9)) {
+		n = n * 10 + (*b - '0');
+		++b;}
+	return true;}
+
+// --------------
+// collatz_format
+// --------------
+
+/**
+ * write n in decimal followed by c
+ * @return one past the last char written, at most 21 after p
+ */
+char* collatz_format (char* p, uint64_t n, char c) {
+	char  t[20];
+	char* q = t + 20;
+	do {
+		*--q = static_cast<char>('0' + n % 10);
+		n /= 10;}
+	while (n != 0);
+	p = copy(q, t + 20, p);
+	*p = c;
+	return p + 1;}
+
 // -------------
 // collatz_solve
 // -------------
 
 void collatz_solve (istream& r, ostream& w) {
-	string s;
-	while (getline(r, s)) {
-		const pair<int, int> p = collatz_read(s);
-		const int            i = p.first;
-		const int            j = p.second;
-		const int            v = collatz_eval(i, j);
-		collatz_print(w, i, j, v);}}
+	// pull IO_SIZE bytes at a time straight from the stream buffer, parse the
+	// lines in place, carrying a partial last line over to the next block,
+	// and write one block of output per block of input
+	streambuf&   in = *r.rdbuf();
+	vector<char> a(IO_SIZE);
+	vector<char> b(IO_SIZE);
+	size_t       n   = 0;
+	bool         eof = false;
+	while (!eof) {
+		if (n == a.size())
+			a.resize(2 * a.size());
+		const streamsize m = in.sgetn(a.data() + n, a.size() - n);
+		eof = (m <= 0);
+		const char* p = a.data();
+		const char* e = p + n + (eof ? 0 : m);
+		char*       q = b.data();
+		while (p != e) {
+			const char* l = static_cast<const char*>(memchr(p, '\n', e - p));
+			if (l == 0) {
+				if (!eof)
+					break;
+				l = e;}
+			uint64_t i;
+			uint64_t j;
+			if (collatz_parse(p, l, i) && collatz_parse(p, l, j)) {
+				const int v = collatz_eval(i, j);
+				if (b.data() + b.size() - q < 64) {
+					w.write(b.data(), q - b.data());
+					q = b.data();}
+				q = collatz_format(q, i, ' ');
+				q = collatz_format(q, j, ' ');
+				q = collatz_format(q, v, '\n');}
+			p = (l == e) ? e : l + 1;}
+		n = e - p;
+		memmove(a.data(), p, n);
+		w.write(b.data(), q - b.data());}
+	w.flush();}
@@ -11,12 +11,35 @@
 // includes
 // --------
 
+#include <cstddef>  // size_t
+#include <cstdint>  // uint32_t, uint64_t
 #include <iostream> // istream, ostream
 #include <string>   // string
 #include <utility>  // pair
 
 using namespace std;
 
+// COLLATZ_SIMD is defined where the AVX2 and AVX-512 kernels can be built,
+// which of them runs is still picked at runtime, see collatz_dispatch
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || (__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))
+#define COLLATZ_SIMD
+#endif
+
+// ------------
+// CollatzWidth
+// ------------
+
+/**
+ * the integer width of the arithmetic in lazy_cache and collatz_eval
+ * wrapping it keeps it out of argument deduction, so collatz_eval(1, 10)
+ * uses the uint64_t default and collatz_eval<uint32_t>(1, 10) narrows it
+ * either way a trajectory that would overflow the width finishes in 128 bits
+ */
+template <typename U>
+struct CollatzWidth {
+    typedef U type;};
+
 // ------------
 // collatz_read
 // ------------
@@ -26,7 +49,31 @@ using namespace std;
  * @param s a string
  * @return a pair of ints, representing the beginning and end of a range, [i, j]
  */
-pair<int, int> collatz_read (const string& s);
+pair<uint64_t, uint64_t> collatz_read (const string& s);
+
+// ------------
+// cycle_length
+// ------------
+
+/**
+ * compute a cycle length directly, without the cache
+ * @param n the input of which length is calculated
+ * @return the number of values on n's trajectory down to 1, inclusive
+ */
+template <typename U = uint64_t>
+int cycle_length (typename CollatzWidth<U>::type n);
+
+// ------------------
+// collatz_cache_init
+// ------------------
+
+/**
+ * resize the cache behind lazy_cache and drop everything in it
+ * lazy_cache may be called from many threads at once, this may not
+ * @param dense    values below this are stored in a flat array
+ * @param overflow the number of hash slots for values at or above dense
+ */
+void collatz_cache_init (std::size_t dense, std::size_t overflow);
 
 // ------------
 // collatz_lazy_cache
@@ -37,7 +84,99 @@ pair<int, int> collatz_read (const string& s);
  * @param x the input of which length is calculated
  * @return a value in the array of length
  */
-int lazy_cache(unsigned int);
+template <typename U = uint64_t>
+int lazy_cache(typename CollatzWidth<U>::type);
+
+// -------------
+// batch kernels
+// -------------
+
+/**
+ * step n[0, count) until each value drops below floor or reaches 2^62
+ * on return n holds where each trajectory stopped and c how many steps it took
+ * the AVX2 and AVX-512 kernels must only be called on CPUs that have them
+ */
+typedef void (*collatz_kernel) (uint64_t* n, int* c, size_t count, uint64_t floor);
+
+void collatz_kernel_scalar (uint64_t* n, int* c, size_t count, uint64_t floor);
+
+#ifdef COLLATZ_SIMD
+void collatz_kernel_avx2   (uint64_t* n, int* c, size_t count, uint64_t floor);
+void collatz_kernel_avx512 (uint64_t* n, int* c, size_t count, uint64_t floor);
+#endif
+
+/**
+ * the widest kernel this CPU runs
+ */
+collatz_kernel collatz_dispatch ();
+
+// ------------------
+// cycle_length_batch
+// ------------------
+
+/**
+ * compute the cycle lengths of count consecutive values at once
+ * eight (AVX2) or sixteen (AVX-512) values step together in vector lanes,
+ * with a scalar loop on CPUs that have neither, picked once at runtime
+ * @param first the first value
+ * @param count the number of values, [first, first + count)
+ * @param out   receives the count cycle lengths
+ */
+void cycle_length_batch (uint64_t first, size_t count, int* out);
+
+// -------------------
+// collatz_index_build
+// -------------------
+
+/**
+ * precompute a range-maximum index over the cycle lengths of [1, bound]
+ * from then on collatz_eval answers any range inside [1, bound] in constant time
+ * @param bound the largest value the index covers
+ */
+void collatz_index_build (unsigned int bound);
+
+// ------------------
+// collatz_index_load
+// ------------------
+
+/**
+ * replace the index with one written by collatz_index_save
+ * @param path the file to read
+ * @return false, leaving the index unchanged, if path is not a valid index
+ */
+bool collatz_index_load (const string& path);
+
+// -----------------
+// collatz_index_map
+// -----------------
+
+/**
+ * like collatz_index_load, but map the file read-only instead of reading it
+ * startup costs no more than the page faults of the first queries, and
+ * every process that maps the same file shares its pages
+ * @param path the file to map
+ * @return false, leaving the index unchanged, if path is not a valid index
+ */
+bool collatz_index_map (const string& path);
+
+// ------------------
+// collatz_index_save
+// ------------------
+
+/**
+ * @param path the file to write
+ * @return false if there is no index or the file could not be written
+ */
+bool collatz_index_save (const string& path);
+
+// -------------------
+// collatz_index_clear
+// -------------------
+
+/**
+ * drop the index, collatz_eval goes back to scanning lazy_cache
+ */
+void collatz_index_clear ();
 
 // ------------
 // collatz_eval
@@ -48,7 +187,23 @@ int lazy_cache(unsigned int);
  * @param j the end       of the range, inclusive
  * @return the max cycle length of the range [i, j]
  */
-int collatz_eval (int i, int j);
+template <typename U = uint64_t>
+int collatz_eval (typename CollatzWidth<U>::type i, typename CollatzWidth<U>::type j);
+
+// ---------------------
+// collatz_eval_parallel
+// ---------------------
+
+/**
+ * split [i, j] into chunks and evaluate them on a pool of threads that
+ * persists between calls, each taking the next chunk off a shared counter
+ * @param i       the beginning of the range, inclusive
+ * @param j       the end       of the range, inclusive
+ * @param threads the number of workers, 0 for one per hardware thread
+ * @return the max cycle length of the range [i, j], same as collatz_eval
+ */
+template <typename U = uint64_t>
+int collatz_eval_parallel (typename CollatzWidth<U>::type i, typename CollatzWidth<U>::type j, unsigned int threads = 0);
 
 // -------------
 // collatz_print
@@ -61,7 +216,7 @@ int collatz_eval (int i, int j);
  * @param j the end       of the range, inclusive
  * @param v the max cycle length
  */
-void collatz_print (ostream& w, int i, int j, int v);
+void collatz_print (ostream& w, uint64_t i, uint64_t j, int v);
 
 // -------------
 // collatz_solve
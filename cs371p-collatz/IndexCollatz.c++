@@ -0,0 +1,40 @@
+// ---------------------------------
+// projects/collatz/IndexCollatz.c++
+// ---------------------------------
+
+// --------
+// includes
+// --------
+
+#include <cstdlib>  // strtoul
+#include <iostream> // cerr, endl
+
+#include "Collatz.h"
+
+// ----
+// main
+// ----
+
+int main (int argc, char* argv[]) {
+    using namespace std;
+    const unsigned long bound = (argc == 3) ? strtoul(argv[1], 0, 10) : 0;
+    if ((bound == 0) || (bound > 0xFFFFFFFFUL)) {
+        cerr << "usage: " << argv[0] << " bound file" << endl;
+        return 1;}
+    collatz_index_build(bound);
+    if (!collatz_index_save(argv[2])) {
+        cerr << argv[0] << ": cannot write " << argv[2] << endl;
+        return 1;}
+    return 0;}
+
+/*
+% g++ -pedantic -std=c++11 -Wall Collatz.c++ IndexCollatz.c++ -o IndexCollatz -pthread
+
+
+
+% ./IndexCollatz 1000000 RunCollatz.idx
+
+
+
+% ./RunCollatz RunCollatz.idx < RunCollatz.in > RunCollatz.out
+*/
@@ -8,7 +8,7 @@
 // includes
 // --------
 
-#include <iostream> // cin, cout
+#include <iostream> // cerr, cin, cout, endl, ios_base
 
 #include "Collatz.h"
 
@@ -16,8 +16,12 @@
 // main
 // ----
 
-int main () {
+int main (int argc, char* argv[]) {
     using namespace std;
+    if ((argc > 1) && !collatz_index_map(argv[1])) {
+        cerr << argv[0] << ": " << argv[1] << " is not a cycle-length index" << endl;
+        return 1;}
+    ios_base::sync_with_stdio(false);
     collatz_solve(cin, cout);
     return 0;}
 
@@ -38,6 +42,11 @@ int main () {
 
 
 
+% ./IndexCollatz 1000000 RunCollatz.idx
+% ./RunCollatz RunCollatz.idx < RunCollatz.in > RunCollatz.out
+
+
+
 % cat RunCollatz.out
 1 10 7
 100 200 27
@@ -10,10 +10,16 @@
 // includes
 // --------
 
-#include <iostream> // cout, endl
-#include <sstream>  // istringtstream, ostringstream
-#include <string>   // string
-#include <utility>  // pair
+#include <algorithm> // equal, max, max_element
+#include <cstdio>    // remove
+#include <iostream>  // cout, endl
+#include <sstream>   // istringtstream, ostringstream
+#include <string>    // string
+#include <thread>    // thread
+#include <utility>   // pair
+#include <vector>    // vector
+
+#include <unistd.h> // truncate
 
 #include "gtest/gtest.h"
 
@@ -53,6 +59,12 @@ TEST(CollatzFixture, read_4) {
     ASSERT_EQ( 9, p.first);
     ASSERT_EQ(99, p.second);}
 
+TEST(CollatzFixture, read_5) {
+    string s("1000000000000 1000000001000\n");
+    const pair<uint64_t, uint64_t> p = collatz_read(s);
+    ASSERT_EQ(1000000000000ULL, p.first);
+    ASSERT_EQ(1000000001000ULL, p.second);}
+
 // -----------
 // lazy_cache
 // -----------
@@ -69,6 +81,131 @@ TEST(CollatzFixture, lazy_cache_3) {
 	const int v = lazy_cache(123);
 	ASSERT_EQ(47, v);}
 
+TEST(CollatzFixture, lazy_cache_4) {
+	const int v = lazy_cache(1000000);
+	ASSERT_EQ(153, v);}
+
+TEST(CollatzFixture, lazy_cache_5) {
+	collatz_cache_init(100, 64);
+	ASSERT_EQ(47, lazy_cache(123));
+	ASSERT_EQ(47, lazy_cache(123));
+	ASSERT_EQ(26, lazy_cache(99));
+	collatz_cache_init(1000000, 65536);}
+
+TEST(CollatzFixture, lazy_cache_6) {
+	vector<thread> t;
+	vector<int>    v(4);
+	for (int k = 0; k < 4; ++k)
+		t.push_back(thread([&v, k] () {
+			for (unsigned int i = 1999000; i < 2000000; ++i)
+				v[k] = max(v[k], lazy_cache(i));}));
+	for (thread& x : t)
+		x.join();
+	ASSERT_EQ(vector<int>(4, 304), v);}
+
+TEST(CollatzFixture, lazy_cache_7) {
+	ASSERT_EQ(112, lazy_cache(27));
+	ASSERT_EQ(110, lazy_cache(41));
+	ASSERT_EQ(111, lazy_cache(82));}
+
+TEST(CollatzFixture, lazy_cache_8) {
+	ASSERT_EQ(525, lazy_cache(837799));
+	ASSERT_EQ(524, lazy_cache(2513398));}
+
+TEST(CollatzFixture, lazy_cache_9) {
+	ASSERT_EQ(184, lazy_cache<uint32_t>(159487));
+	ASSERT_EQ(184, lazy_cache(159487));}
+
+TEST(CollatzFixture, lazy_cache_10) {
+	ASSERT_EQ(147, lazy_cache(1000000000000ULL));
+	ASSERT_EQ(864, lazy_cache(18446744073709551615ULL));
+	ASSERT_EQ(486, lazy_cache(12297829382473034411ULL));}
+
+TEST(CollatzFixture, lazy_cache_11) {
+	ASSERT_EQ(131, lazy_cache(65535));
+	ASSERT_EQ( 17, lazy_cache(65536));
+	ASSERT_EQ(100, lazy_cache(65537));}
+
+TEST(CollatzFixture, lazy_cache_12) {
+	ASSERT_EQ(452, lazy_cache<uint32_t>(4294967295U));
+	ASSERT_EQ(452, lazy_cache(4294967295U));}
+
+// ------------
+// cycle_length
+// ------------
+
+TEST(CollatzFixture, cycle_length_1) {
+	ASSERT_EQ(  1, cycle_length(1));
+	ASSERT_EQ(112, cycle_length(27));
+	ASSERT_EQ(525, cycle_length(837799));}
+
+TEST(CollatzFixture, cycle_length_2) {
+	ASSERT_EQ(452, cycle_length<uint32_t>(4294967295U));
+	ASSERT_EQ(864, cycle_length(18446744073709551615ULL));}
+
+// -----
+// batch
+// -----
+
+TEST(CollatzFixture, batch_1) {
+    int out[10];
+    cycle_length_batch(1, 10, out);
+    const int v[10] = {1, 2, 8, 3, 6, 9, 17, 4, 20, 7};
+    ASSERT_TRUE(equal(v, v + 10, out));}
+
+TEST(CollatzFixture, batch_2) {
+    vector<int> out(3000);
+    cycle_length_batch(999000, out.size(), out.data());
+    for (size_t k = 0; k < out.size(); ++k)
+        ASSERT_EQ(lazy_cache(999000 + k), out[k]);}
+
+TEST(CollatzFixture, batch_3) {
+    vector<int> out(100);
+    cycle_length_batch(4611686018427387850ULL, out.size(), out.data());
+    ASSERT_EQ(lazy_cache(4611686018427387850ULL), out[0]);
+    ASSERT_EQ(lazy_cache(4611686018427387949ULL), out[99]);
+    ASSERT_EQ(862, *max_element(out.begin(), out.end()));}
+
+// -------
+// kernels
+// -------
+
+/**
+ * run k over [first, first + count) down to floor, and check that every value
+ * stopped below floor or at the lane cap, with its steps making up its cycle length
+ */
+static void kernel_check (collatz_kernel k, uint64_t first, size_t count, uint64_t floor) {
+    vector<uint64_t> n(count);
+    vector<int>      c(count);
+    for (size_t i = 0; i < count; ++i)
+        n[i] = first + i;
+    k(n.data(), c.data(), count, floor);
+    for (size_t i = 0; i < count; ++i) {
+        ASSERT_TRUE((n[i] < floor) || (n[i] >= (1ULL << 62)));
+        ASSERT_EQ(cycle_length(first + i), c[i] + cycle_length(n[i]));}}
+
+static void kernel_checks (collatz_kernel k) {
+    kernel_check(k, 1, 37, 2);
+    kernel_check(k, 999000, 100, 500000);
+    kernel_check(k, 4611686018427387850ULL, 40, 2);}
+
+TEST(CollatzFixture, kernel_scalar) {
+    kernel_checks(collatz_kernel_scalar);}
+
+#ifdef COLLATZ_SIMD
+// on a CPU without the instructions there is nothing to run
+TEST(CollatzFixture, kernel_avx2) {
+    if (__builtin_cpu_supports("avx2"))
+        kernel_checks(collatz_kernel_avx2);}
+
+TEST(CollatzFixture, kernel_avx512) {
+    if (__builtin_cpu_supports("avx512f"))
+        kernel_checks(collatz_kernel_avx512);}
+#endif
+
+TEST(CollatzFixture, kernel_dispatch) {
+    kernel_checks(collatz_dispatch());}
+
 // ----
 // eval
 // ----
@@ -105,6 +242,89 @@ TEST(CollatzFixture, eval_8) {
     const int v = collatz_eval(23, 456);
     ASSERT_EQ(144, v);}
 
+TEST(CollatzFixture, eval_9) {
+    const int v = collatz_eval(1000000000000ULL, 1000000001000ULL);
+    ASSERT_EQ(509, v);}
+
+TEST(CollatzFixture, eval_10) {
+    const int v = collatz_eval<uint32_t>(4294967295U, 4294967000U);
+    ASSERT_EQ(483, v);}
+
+// -------------
+// eval_parallel
+// -------------
+
+TEST(CollatzFixture, eval_parallel_1) {
+    const int v = collatz_eval_parallel(1, 10, 4);
+    ASSERT_EQ(20, v);}
+
+TEST(CollatzFixture, eval_parallel_2) {
+    const int v = collatz_eval_parallel(1, 100000, 4);
+    ASSERT_EQ(351, v);}
+
+TEST(CollatzFixture, eval_parallel_3) {
+    const int v = collatz_eval_parallel(300000, 1, 3);
+    ASSERT_EQ(collatz_eval(1, 300000), v);}
+
+TEST(CollatzFixture, eval_parallel_4) {
+    const int v = collatz_eval_parallel(20000, 90000);
+    ASSERT_EQ(collatz_eval(20000, 90000), v);}
+
+// -----
+// index
+// -----
+
+TEST(CollatzFixture, index_1) {
+    collatz_index_build(10000);
+    ASSERT_EQ( 20, collatz_eval(1, 10));
+    ASSERT_EQ(125, collatz_eval(200, 100));
+    ASSERT_EQ(260, collatz_eval(9001, 9500));
+    ASSERT_EQ( 41, collatz_eval(2456, 2456));
+    collatz_index_clear();}
+
+TEST(CollatzFixture, index_2) {
+    collatz_index_build(50000);
+    const int v = collatz_eval(1, 49999);
+    collatz_index_clear();
+    ASSERT_EQ(collatz_eval(1, 49999), v);}
+
+TEST(CollatzFixture, index_3) {
+    collatz_index_build(30000);
+    ASSERT_TRUE(collatz_index_save("TestCollatz.idx"));
+    collatz_index_clear();
+    ASSERT_TRUE(collatz_index_load("TestCollatz.idx"));
+    remove("TestCollatz.idx");
+    const int v = collatz_eval(21000, 22000);
+    collatz_index_clear();
+    ASSERT_EQ(269, v);}
+
+TEST(CollatzFixture, index_4) {
+    ASSERT_FALSE(collatz_index_save("TestCollatz.idx"));
+    ASSERT_FALSE(collatz_index_load("RunCollatz.in"));
+    ASSERT_EQ(20, collatz_eval(1, 10));}
+
+TEST(CollatzFixture, index_5) {
+    collatz_index_build(40000);
+    ASSERT_TRUE(collatz_index_save("TestCollatz.idx"));
+    collatz_index_clear();
+    ASSERT_TRUE(collatz_index_map("TestCollatz.idx"));
+    remove("TestCollatz.idx");
+    const int v = collatz_eval(27000, 28000);
+    const int w = collatz_eval(1, 40000);
+    collatz_index_clear();
+    ASSERT_EQ(259, v);
+    ASSERT_EQ(collatz_eval(1, 40000), w);}
+
+TEST(CollatzFixture, index_6) {
+    collatz_index_build(40000);
+    ASSERT_TRUE(collatz_index_save("TestCollatz.idx"));
+    collatz_index_clear();
+    ASSERT_EQ(0, truncate("TestCollatz.idx", 1000));
+    ASSERT_FALSE(collatz_index_map("TestCollatz.idx"));
+    ASSERT_FALSE(collatz_index_load("TestCollatz.idx"));
+    remove("TestCollatz.idx");
+    ASSERT_FALSE(collatz_index_map("TestCollatz.idx"));}
+
 // -----
 // print
 // -----
@@ -129,6 +349,11 @@ TEST(CollatzFixture, print_4) {
     collatz_print(w, 21, 28, 57);
     ASSERT_EQ("21 28 57\n", w.str());}
 
+TEST(CollatzFixture, print_5) {
+    ostringstream w;
+    collatz_print(w, 1000000000000ULL, 1000000001000ULL, 509);
+    ASSERT_EQ("1000000000000 1000000001000 509\n", w.str());}
+
 // -----
 // solve
 // -----
@@ -157,6 +382,29 @@ TEST(CollatzFixture, solve_4) {
     collatz_solve(r, w);
     ASSERT_EQ("10 1 20\n200 100 125\n21000 22000 269\n27000 28000 259\n", w.str());}
 
+TEST(CollatzFixture, solve_5) {
+    istringstream r("8400511 8400511\n1000000001000 1000000000000\n");
+    ostringstream w;
+    collatz_solve(r, w);
+    ASSERT_EQ("8400511 8400511 686\n1000000001000 1000000000000 509\n", w.str());}
+
+TEST(CollatzFixture, solve_6) {
+    istringstream r("1 10\r\n\n  100\t200 \n201 210");
+    ostringstream w;
+    collatz_solve(r, w);
+    ASSERT_EQ("1 10 20\n100 200 125\n201 210 89\n", w.str());}
+
+TEST(CollatzFixture, solve_7) {
+    ostringstream s;
+    ostringstream t;
+    for (uint64_t i = 1; i <= 20000; ++i) {
+        s << i << " " << i + i % 100 << "\n";
+        collatz_print(t, i, i + i % 100, collatz_eval(i, i + i % 100));}
+    istringstream r(s.str());
+    ostringstream w;
+    collatz_solve(r, w);
+    ASSERT_EQ(t.str(), w.str());}
+
 /*
 % g++ -fprofile-arcs -ftest-coverage -pedantic -std=c++11 -Wall Collatz.c++ TestCollatz.c++ -o TestCollatz -lgtest -lgtest_main -lpthread
 
@@ -1,4 +1,5 @@
 #include <cassert>
+#include <algorithm> //equal, fill, max, min, sort
 #include "Life.h"
 
 using namespace std;
@@ -272,3 +273,659 @@ bool Cell::evolve(AbstractCell** const neighbors) {
 AbstractCell* Cell::operator& () {
 	return _ptr;
 }
+
+// --------
+// Barrier Constructor
+// --------
+
+/**
+* @brief The Barrier constructor takes in the number of threads to wait for and what to do once they all have
+* @param int count: the number of threads that call wait
+* @param function<void()> done: called by the last thread to get to wait, before any of them go on
+*/
+Barrier::Barrier(int count, function<void()> done) : count(count), done(done) {}
+
+// --------
+// wait
+// --------
+
+/**
+* @brief This method blocks until count threads have called it, the last of them calls done
+*/
+void Barrier::wait() {
+	unique_lock<mutex> l(lock);
+	if (++waiting == count) {
+		waiting = 0;
+		done();
+		++phase;
+		turn.notify_all();
+	} else {
+		int p = phase;
+		turn.wait(l, [&] {return phase != p;});
+	}
+}
+
+// --------
+// Bands Destructor
+// --------
+
+/**
+* @brief The Bands destructor stops the workers and joins them
+*/
+Bands::~Bands() {
+	{
+		lock_guard<mutex> l(lock);
+		stop = true;
+	}
+	wake.notify_all();
+	for (thread& t : workers)
+		t.join();
+}
+
+// --------
+// work
+// --------
+
+/**
+* @brief This method runs job(band) once for every call of run that wants the band, until the Bands are destroyed
+* @param int band: the band of this worker, from 1
+*/
+void Bands::work(int band) {
+	int seen = 0;
+	unique_lock<mutex> l(lock);
+	while (true) {
+		wake.wait(l, [&] {return stop || generation != seen;});
+		if (stop)
+			return;
+		seen = generation;
+		if (band >= wanted)
+			continue;
+		l.unlock();
+		job(band);
+		l.lock();
+		if (--running == 0)
+			idle.notify_one();
+	}
+}
+
+// --------
+// run
+// --------
+
+/**
+* @brief This method calls job(band) for every band in [0, bands), band 0 on the calling thread and the rest on workers, and returns once they all have
+* @param int bands: the number of bands
+* @param function<void(int)> job: what to do for a band
+*/
+void Bands::run(int bands, function<void(int)> job) {
+	{
+		lock_guard<mutex> l(lock);
+		while ((int)workers.size() + 1 < bands)
+			workers.push_back(thread(&Bands::work, this, (int)workers.size() + 1));
+		this->job = job;
+		wanted = bands;
+		running = bands - 1;
+		++generation;
+	}
+	wake.notify_all();
+	job(0);
+	unique_lock<mutex> l(lock);
+	idle.wait(l, [&] {return running == 0;});
+}
+
+// --------
+// life_bands
+// --------
+
+/**
+* @brief This function picks how many bands of rows to split a generation into
+* @param int threads: the number of threads to use, or 0 for up to one per hardware thread, each with at least LIFE_BAND_WORK of work
+* @param int rows: the most bands, the rows of tiles on the board
+* @param long long work: the cells, or words of cells, in a generation
+* @return int: the number of bands, at least 1 and at most rows
+*/
+int life_bands(int threads, int rows, long long work) {
+	long long bands = threads;
+	if (threads <= 0)
+		bands = min<long long>(thread::hardware_concurrency(), work / LIFE_BAND_WORK);
+	bands = min<long long>(bands, rows);
+	return bands < 1 ? 1 : bands;
+}
+
+// --------
+// Tiles Constructor
+// --------
+
+/**
+* @brief The Tiles constructor takes in the size of the board, with every tile awake
+* @param int row: the rows of the board
+* @param int col: the columns, or words, across the board
+* @param int width: the columns, or words, across a tile
+*/
+Tiles::Tiles(int row, int col, int width) : rows((row + LIFE_TILE - 1) / LIFE_TILE), cols((col + width - 1) / width), awake(rows * cols, 1), changed(rows * cols, 0) {
+	wake();
+}
+
+// --------
+// turn
+// --------
+
+/**
+* @brief This method wakes the tiles next to or at one that changed, and puts the rest to sleep, once a generation has been stepped.
+* Only the tiles awake can have changed, so no other tile is looked at
+*/
+void Tiles::turn() {
+	spare.clear();
+	for (int t : list) {
+		awake[t] = 0;
+		if (changed[t]) {
+			changed[t] = 0;
+			spare.push_back(t);
+		}
+	}
+	int n = spare.size();
+	for (int k = 0; k < n; ++k) {
+		int i = spare[k] / cols, j = spare[k] % cols;
+		for (int y = max(i - 1, 0); y <= min(i + 1, rows - 1); ++y)
+			for (int x = max(j - 1, 0); x <= min(j + 1, cols - 1); ++x)
+				if (!awake[y*cols + x]) {
+					awake[y*cols + x] = 1;
+					spare.push_back(y*cols + x);
+				}
+	}
+	list.assign(spare.begin() + n, spare.end());
+	sort(list.begin(), list.end());
+}
+
+// --------
+// wake
+// --------
+
+/**
+* @brief This method wakes every tile, for when the board has changed other than by stepping it
+*/
+void Tiles::wake() {
+	fill(awake.begin(), awake.end(), 1);
+	list.resize(awake.size());
+	for (int t = 0; t < (int) list.size(); ++t)
+		list[t] = t;
+}
+
+// --------
+// active
+// --------
+
+/**
+* @brief This method returns the number of tiles awake
+* @return int: the tiles
+*/
+int Tiles::active() const {
+	return list.size();
+}
+
+// --------
+// Node Constructor
+// --------
+
+/**
+* @brief The Node constructor takes in the four quarters of a node, or four NULLs for a single cell
+* @param Node* nw, ne, sw, se: the quarters
+* @param int level: the node is 2^level cells on a side
+* @param long long pop: the live cells in the node
+*/
+HashLife::Node::Node(Node* nw, Node* ne, Node* sw, Node* se, int level, long long pop) : level(level), pop(pop), next(NULL), step(-1) {
+	q[0] = nw;
+	q[1] = ne;
+	q[2] = sw;
+	q[3] = se;
+	for (int k = 0; k < 4; ++k)
+		edge[k] = -2;
+}
+
+// --------
+// Quad
+// --------
+
+/**
+* @brief Two quads are equal if they have the same four quarters
+*/
+bool HashLife::Quad::operator == (const Quad& rhs) const {
+	return equal(q, q + 4, rhs.q);
+}
+
+/**
+* @brief This hashes the addresses of the four quarters
+*/
+size_t HashLife::QuadHash::operator () (const Quad& k) const {
+	size_t h = 0;
+	for (int i = 0; i < 4; ++i)
+		h = (h ^ (reinterpret_cast<uintptr_t>(k.q[i]) >> 4)) * 0x9E3779B97F4A7C15ULL;
+	return h ^ (h >> 29);
+}
+
+// --------
+// HashLife Constructor
+// --------
+
+/**
+* @brief The HashLife constructor takes in the most nodes to keep
+* @param size_t limit: when a jump needs more nodes than this, all but those of the board are thrown away
+*/
+HashLife::HashLife(size_t limit) : limit(limit) {
+	reset();
+}
+
+// --------
+// HashLife Copy Constructor
+// --------
+
+/**
+* @brief The HashLife copy constructor makes its own nodes for the board of rhs, since the nodes of rhs go when it does
+* @param const HashLife& rhs: the HashLife to copy
+*/
+HashLife::HashLife(const HashLife& rhs) : limit(rhs.limit) {
+	*this = rhs;
+}
+
+// --------
+// operator =
+// --------
+
+/**
+* @brief This method throws away every node and makes its own for the board of rhs
+* @param const HashLife& rhs: the HashLife to copy
+* @return HashLife&: this
+*/
+HashLife& HashLife::operator = (const HashLife& rhs) {
+	if (this == &rhs)
+		return *this;
+	limit = rhs.limit;
+	row = rhs.row;
+	col = rhs.col;
+	reset();
+	if (rhs.board != NULL) {
+		unordered_map<Node*, Node*> done;
+		board = copy(rhs.board, done);
+	}
+	return *this;
+}
+
+// --------
+// reset
+// --------
+
+/**
+* @brief This method throws away every node and makes the two single cells again
+*/
+void HashLife::reset() {
+	nodes.clear();
+	table.clear();
+	nodes.emplace_back((Node*) NULL, (Node*) NULL, (Node*) NULL, (Node*) NULL, 0, 0);
+	cells[0] = &nodes.back();
+	nodes.emplace_back((Node*) NULL, (Node*) NULL, (Node*) NULL, (Node*) NULL, 0, 1);
+	cells[1] = &nodes.back();
+	empties.assign(1, cells[0]);
+	board = NULL;
+}
+
+// --------
+// collect
+// --------
+
+/**
+* @brief This method throws away every node but those of the board
+*/
+void HashLife::collect() {
+	deque<Node> old;
+	old.swap(nodes);
+	Node* b = board;
+	reset();
+	unordered_map<Node*, Node*> done;
+	board = copy(b, done);
+}
+
+// --------
+// join
+// --------
+
+/**
+* @brief This method returns the one node with the given quarters, made if there is none yet
+* @param Node* nw, ne, sw, se: the quarters, all of one level
+* @return Node*: the node
+*/
+HashLife::Node* HashLife::join(Node* nw, Node* ne, Node* sw, Node* se) {
+	Quad k = {{nw, ne, sw, se}};
+	unordered_map<Quad, Node*, QuadHash>::iterator i = table.find(k);
+	if (i != table.end())
+		return i->second;
+	nodes.emplace_back(nw, ne, sw, se, nw->level + 1, nw->pop + ne->pop + sw->pop + se->pop);
+	return table[k] = &nodes.back();
+}
+
+// --------
+// empty
+// --------
+
+/**
+* @brief This method returns the node of the given level with no live cells
+* @param int level: the level
+* @return Node*: the node
+*/
+HashLife::Node* HashLife::empty(int level) {
+	while ((int) empties.size() <= level) {
+		Node* e = empties.back();
+		empties.push_back(join(e, e, e, e));
+	}
+	return empties[level];
+}
+
+// --------
+// base
+// --------
+
+/**
+* @brief This method returns the middle half of a 4x4 node one generation on, by the rules of ConwayCell
+* @param Node* n: a node of level 2
+* @return Node*: the node of level 1 in the middle of n, one generation on
+*/
+HashLife::Node* HashLife::base(Node* n) {
+	int alive[4][4];
+	for (int y = 0; y < 4; ++y)
+		for (int x = 0; x < 4; ++x)
+			alive[y][x] = n->q[(y / 2) * 2 + x / 2]->q[(y % 2) * 2 + x % 2]->pop;
+	Node* r[4];
+	for (int y = 1; y <= 2; ++y) {
+		for (int x = 1; x <= 2; ++x) {
+			int count = 0;
+			for (int dy = -1; dy <= 1; ++dy)
+				for (int dx = -1; dx <= 1; ++dx)
+					if (dy != 0 || dx != 0)
+						count += alive[y + dy][x + dx];
+			r[(y - 1) * 2 + x - 1] = cells[count == 3 || (alive[y][x] && count == 2)];
+		}
+	}
+	return join(r[0], r[1], r[2], r[3]);
+}
+
+// --------
+// next
+// --------
+
+/**
+* @brief This method returns the middle half of a node 2^j generations on, remembering it in the node
+* @param Node* n: a node of level 2 or more
+* @param int j: no more than the level of n less 2
+* @return Node*: the node one level down in the middle of n, 2^j generations on, or NULL if that needs more nodes than the limit
+*/
+HashLife::Node* HashLife::next(Node* n, int j) {
+	if (n->pop == 0)
+		return empty(n->level - 1);
+	if (n->next != NULL && n->step == j)
+		return n->next;
+	if (nodes.size() > limit)
+		return NULL;
+	Node* r;
+	if (n->level == 2) {
+		r = base(n);
+	} else {
+		Node* a = n->q[0];
+		Node* b = n->q[1];
+		Node* c = n->q[2];
+		Node* d = n->q[3];
+		int k = min(j, n->level - 3);
+		Node* m[9] = {
+			next(a, k),
+			next(join(a->q[1], b->q[0], a->q[3], b->q[2]), k),
+			next(b, k),
+			next(join(a->q[2], a->q[3], c->q[0], c->q[1]), k),
+			next(join(a->q[3], b->q[2], c->q[1], d->q[0]), k),
+			next(join(b->q[2], b->q[3], d->q[0], d->q[1]), k),
+			next(c, k),
+			next(join(c->q[1], d->q[0], c->q[3], d->q[2]), k),
+			next(d, k)};
+		for (Node* x : m)
+			if (x == NULL)
+				return NULL;
+		if (j < n->level - 2) {
+			r = join(join(m[0]->q[3], m[1]->q[2], m[3]->q[1], m[4]->q[0]),
+			         join(m[1]->q[3], m[2]->q[2], m[4]->q[1], m[5]->q[0]),
+			         join(m[3]->q[3], m[4]->q[2], m[6]->q[1], m[7]->q[0]),
+			         join(m[4]->q[3], m[5]->q[2], m[7]->q[1], m[8]->q[0]));
+		} else {
+			Node* s[4] = {
+				next(join(m[0], m[1], m[3], m[4]), k),
+				next(join(m[1], m[2], m[4], m[5]), k),
+				next(join(m[3], m[4], m[6], m[7]), k),
+				next(join(m[4], m[5], m[7], m[8]), k)};
+			for (Node* x : s)
+				if (x == NULL)
+					return NULL;
+			r = join(s[0], s[1], s[2], s[3]);
+		}
+	}
+	n->next = r;
+	n->step = j;
+	return r;
+}
+
+// --------
+// edge
+// --------
+
+/**
+* @brief This method returns the first live row, first live column, last live row or last live column of a node, remembering it in the node
+* @param Node* n: the node
+* @param int k: 0, 1, 2 or 3 for the first row, first column, last row or last column
+* @return int: the row or column, from the northwest corner of n, or -1 if every cell is dead
+*/
+int HashLife::edge(Node* n, int k) {
+	if (n->pop == 0)
+		return -1;
+	if (n->level == 0)
+		return 0;
+	if (n->edge[k] != -2)
+		return n->edge[k];
+	// the quarters by rows and by columns, the first or last two first
+	static const int halves[2][2][2] = {{{0, 1}, {2, 3}}, {{0, 2}, {1, 3}}};
+	bool first = k < 2;
+	for (int t = 0; t < 2; ++t) {
+		int h = first ? t : 1 - t;
+		int best = -1;
+		for (int i : halves[k % 2][h]) {
+			int e = edge(n->q[i], k);
+			if (e >= 0 && (best < 0 || (first ? e < best : e > best)))
+				best = e;
+		}
+		if (best >= 0)
+			return n->edge[k] = best + h * (1 << (n->level - 1));
+	}
+	return -1;
+}
+
+// --------
+// copy
+// --------
+
+/**
+* @brief This method makes a node again out of nodes from before a reset, or from another HashLife
+* @param Node* n: the node from before the reset, or from the other HashLife
+* @param unordered_map<Node*, Node*>& done: the nodes made again so far
+* @return Node*: the node made again
+*/
+HashLife::Node* HashLife::copy(Node* n, unordered_map<Node*, Node*>& done) {
+	if (n->level == 0)
+		return cells[n->pop];
+	unordered_map<Node*, Node*>::iterator i = done.find(n);
+	if (i != done.end())
+		return i->second;
+	return done[n] = join(copy(n->q[0], done), copy(n->q[1], done), copy(n->q[2], done), copy(n->q[3], done));
+}
+
+// --------
+// build
+// --------
+
+/**
+* @brief This method makes the node for a square of a board of bits
+* @param const vector<uint64_t>& grid: the bits
+* @param int words: the words in a row
+* @param int level: the square is 2^level cells on a side
+* @param int y, x: the northwest corner of the square
+* @return Node*: the node
+*/
+HashLife::Node* HashLife::build(const vector<uint64_t>& grid, int words, int level, int y, int x) {
+	if (y >= row || x >= col)
+		return empty(level);
+	if (level == 0)
+		return cells[(grid[y * words + x / 64] >> (x % 64)) & 1];
+	int side = 1 << level;
+	if (side <= 64) {
+		uint64_t mask = side == 64 ? ~uint64_t(0) : ((uint64_t(1) << side) - 1) << (x % 64);
+		bool any = false;
+		for (int i = y; i < y + side && i < row; ++i)
+			any = any || (grid[i * words + x / 64] & mask) != 0;
+		if (!any)
+			return empty(level);
+	}
+	int half = side / 2;
+	return join(build(grid, words, level - 1, y, x),
+	            build(grid, words, level - 1, y, x + half),
+	            build(grid, words, level - 1, y + half, x),
+	            build(grid, words, level - 1, y + half, x + half));
+}
+
+// --------
+// write
+// --------
+
+/**
+* @brief This method sets the bits of the live cells of a node that are on the board
+* @param Node* n: the node
+* @param vector<uint64_t>& grid: the bits
+* @param int words: the words in a row
+* @param int y, x: the northwest corner of the node
+*/
+void HashLife::write(Node* n, vector<uint64_t>& grid, int words, int y, int x) const {
+	if (n->pop == 0 || y >= row || x >= col)
+		return;
+	if (n->level == 0) {
+		grid[y * words + x / 64] |= uint64_t(1) << (x % 64);
+		return;
+	}
+	int half = 1 << (n->level - 1);
+	write(n->q[0], grid, words, y, x);
+	write(n->q[1], grid, words, y, x + half);
+	write(n->q[2], grid, words, y + half, x);
+	write(n->q[3], grid, words, y + half, x + half);
+}
+
+// --------
+// load
+// --------
+
+/**
+* @brief This method replaces the board with a board of bits, one row after another, 64 cells to a word
+* @param const vector<uint64_t>& grid: the bits
+* @param int row, col: the size of the board
+* @param int words: the words in a row
+*/
+void HashLife::load(const vector<uint64_t>& grid, int row, int col, int words) {
+	this->row = row;
+	this->col = col;
+	int level = 2;
+	while ((1 << level) < max(row, col))
+		++level;
+	board = build(grid, words, level, 0, 0);
+}
+
+// --------
+// store
+// --------
+
+/**
+* @brief This method writes the board out as bits, laid out as for load
+* @param vector<uint64_t>& grid: the bits, row * words of them
+* @param int words: the words in a row
+*/
+void HashLife::store(vector<uint64_t>& grid, int words) {
+	fill(grid.begin(), grid.end(), 0);
+	write(board, grid, words, 0, 0);
+}
+
+// --------
+// margin
+// --------
+
+/**
+* @brief This method returns how many generations the board can go on before a live cell could be next to an edge, as no cell travels faster than one a generation
+* @return int: the fewest rows or columns between a live cell and an edge, or -1 if every cell is dead
+*/
+int HashLife::margin() {
+	if (board->pop == 0)
+		return -1;
+	return min(min(edge(board, 0), edge(board, 1)), min(row - 1 - edge(board, 2), col - 1 - edge(board, 3)));
+}
+
+// --------
+// jump
+// --------
+
+/**
+* @brief This method moves the board up to 2^j generations on, as if there were no edges.
+* Should the nodes run past the limit on the way, all but those of the board are thrown away and the jump starts over, half as far if that happens twice
+* @param int j: no more than what margin allows, and less than the log of the board's size
+* @return int: the power of 2 generations the board moved on, j or less
+*/
+int HashLife::jump(int j) {
+	bool collected = false;
+	while (true) {
+		Node* e = empty(board->level - 1);
+		Node* root = join(join(e, e, e, board->q[0]),
+		                  join(e, e, board->q[1], e),
+		                  join(e, board->q[2], e, e),
+		                  join(board->q[3], e, e, e));
+		Node* r = next(root, j);
+		if (r == NULL && collected && j == 0) {
+			// a board too big for the limit still moves on a generation
+			size_t l = limit;
+			limit = (size_t) -1;
+			r = next(root, 0);
+			limit = l;
+		}
+		if (r != NULL) {
+			board = r;
+			break;
+		}
+		if (collected)
+			--j;
+		collect();
+		collected = true;
+	}
+	if (nodes.size() > limit)
+		collect();
+	return j;
+}
+
+// --------
+// population
+// --------
+
+/**
+* @brief This method returns the number of live cells on the board
+* @return long long: the population
+*/
+long long HashLife::population() const {
+	return board == NULL ? 0 : board->pop;
+}
+
+// --------
+// size
+// --------
+
+/**
+* @brief This method returns the number of nodes kept
+* @return size_t: the nodes
+*/
+size_t HashLife::size() const {
+	return nodes.size();
+}
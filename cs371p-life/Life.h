@@ -1,7 +1,15 @@
+#include <cstdint>  //uint64_t
 #include <string>   //string
 #include <vector>   //vector
 #include <iostream> //istream, ostream
 #include <sstream>  //istringstream
+#include <algorithm> //lower_bound, min
+#include <condition_variable> //condition_variable
+#include <deque>    //deque
+#include <functional> //function
+#include <mutex>    //mutex, unique_lock
+#include <thread>   //thread
+#include <unordered_map> //unordered_map
 
 using namespace std;
 
@@ -226,6 +234,405 @@ public:
 
 };
 
+// --------
+// Barrier
+// --------
+
+/**
+* @brief A Barrier holds back each of a fixed number of threads at wait until all of them have got there, then lets them all go on
+*/
+class Barrier {
+private:
+	mutex lock;
+	condition_variable turn;
+	int count;
+	int waiting = 0;
+	int phase = 0;
+	function<void()> done;
+
+public:
+
+	// --------
+	// Barrier Constructor
+	// --------
+
+	/**
+	* @brief The Barrier constructor takes in the number of threads to wait for and what to do once they all have
+	* @param int count: the number of threads that call wait
+	* @param function<void()> done: called by the last thread to get to wait, before any of them go on
+	*/
+	Barrier(int count, function<void()> done);
+
+	// --------
+	// wait
+	// --------
+
+	/**
+	* @brief This method blocks until count threads have called it, the last of them calls done
+	*/
+	void wait();
+};
+
+// --------
+// Bands
+// --------
+
+/**
+* @brief Bands are worker threads that a board keeps for as long as it lives, so that stepping it in bands does not start and join a thread per band on every call.
+* A copy starts with no workers of its own, they are started the first time run needs them
+*/
+class Bands {
+private:
+	mutex lock;
+	condition_variable wake;
+	condition_variable idle;
+	vector<thread> workers;
+	function<void(int)> job;
+	int generation = 0;
+	int wanted = 0; // workers 1 through wanted - 1 run job
+	int running = 0; // of them, those not done yet
+	bool stop = false;
+
+	void work(int band);
+
+public:
+	Bands() {}
+	Bands(const Bands&) {}
+	Bands& operator = (const Bands&) {
+		return *this;
+	}
+
+	// --------
+	// Bands Destructor
+	// --------
+
+	/**
+	* @brief The Bands destructor stops the workers and joins them
+	*/
+	~Bands();
+
+	// --------
+	// run
+	// --------
+
+	/**
+	* @brief This method calls job(band) for every band in [0, bands), band 0 on the calling thread and the rest on workers, and returns once they all have
+	* @param int bands: the number of bands
+	* @param function<void(int)> job: what to do for a band
+	*/
+	void run(int bands, function<void(int)> job);
+};
+
+// --------
+// life_bands
+// --------
+
+// the fewest cells, or words of cells, worth a band of their own
+#define LIFE_BAND_WORK 65536
+
+/**
+* @brief This function picks how many bands of rows to split a generation into
+* @param int threads: the number of threads to use, or 0 for up to one per hardware thread, each with at least LIFE_BAND_WORK of work
+* @param int rows: the most bands, the rows of tiles on the board
+* @param long long work: the cells, or words of cells, in a generation
+* @return int: the number of bands, at least 1 and at most rows
+*/
+int life_bands(int threads, int rows, long long work);
+
+// --------
+// Tiles
+// --------
+
+// the rows in a tile, and the cells across one where there are not 64 to a word
+#define LIFE_TILE 16
+
+/**
+* @brief Tiles split a board into tiles and keeps the ones awake that may change in the next generation, those next to or at a tile that changed in the last one.
+* A cell can only change if a cell beside it or itself changed in the last generation, so every other tile can go on as it is
+*/
+class Tiles {
+private:
+	int rows;
+	int cols;
+	vector<char> awake;
+	vector<char> changed;
+	vector<int> list;  // the tiles awake, in order
+	vector<int> spare; // the tiles that changed, then the next list
+
+public:
+
+	// --------
+	// Tiles Constructor
+	// --------
+
+	/**
+	* @brief The Tiles constructor takes in the size of the board, with every tile awake
+	* @param int row: the rows of the board
+	* @param int col: the columns, or words, across the board
+	* @param int width: the columns, or words, across a tile
+	*/
+	Tiles(int row, int col, int width);
+
+	// --------
+	// asleep
+	// --------
+
+	/**
+	* @brief This method returns whether a tile cannot change in the next generation
+	* @param int i, j: the tile, LIFE_TILE rows and width columns to one
+	* @return bool: true if the tile can be skipped
+	*/
+	bool asleep(int i, int j) const {
+		return !awake[i*cols + j];
+	}
+
+	// --------
+	// change
+	// --------
+
+	/**
+	* @brief This method marks a tile as changed in the generation being stepped, to be called only for a tile awake and from the band holding it
+	* @param int i, j: the tile
+	*/
+	void change(int i, int j) {
+		changed[i*cols + j] = 1;
+	}
+
+	// --------
+	// each
+	// --------
+
+	/**
+	* @brief This method calls f on every tile awake in some rows of tiles, so that the tiles asleep are never looked at
+	* @param int begin, end: the rows of tiles, begin included and end not
+	* @param F f: called with the row and column of each tile, in order
+	*/
+	template<typename F>
+	void each(int begin, int end, F f) const {
+		for(auto k = lower_bound(list.begin(), list.end(), begin*cols); k != list.end() && *k < end*cols; ++k)
+			f(*k / cols, *k % cols);
+	}
+
+	// --------
+	// turn
+	// --------
+
+	/**
+	* @brief This method wakes the tiles next to or at one that changed, and puts the rest to sleep, once a generation has been stepped.
+	* Only the tiles awake can have changed, so no other tile is looked at
+	*/
+	void turn();
+
+	// --------
+	// wake
+	// --------
+
+	/**
+	* @brief This method wakes every tile, for when the board has changed other than by stepping it
+	*/
+	void wake();
+
+	// --------
+	// active
+	// --------
+
+	/**
+	* @brief This method returns the number of tiles awake
+	* @return int: the tiles
+	*/
+	int active() const;
+};
+
+// --------
+// in_bands
+// --------
+
+/**
+* @brief This function runs generations of a board split into bands of rows, one thread per band, the calling thread taking the first and the workers of pool the rest.
+* Bands start and end on a row of tiles, so no tile is in two bands, and every band waits for the others at a barrier between generations
+* @param Bands& pool: the workers of the board
+* @param int bands: the number of bands, no more than the rows of tiles
+* @param int rows: the number of rows on the board
+* @param int generations: the number of generations to run
+* @param F step: step(begin, end, band) computes rows [begin, end) of the next generation, it must not write outside them
+* @param function<void()> done: called once per generation, by one thread, after every band has been stepped and before any goes on to the next generation
+*/
+template <typename F>
+void in_bands(Bands& pool, int bands, int rows, int generations, F step, function<void()> done){
+	if(bands <= 1){
+		for(int g = 0; g < generations; ++g){
+			step(0, rows, 0);
+			done();
+		}
+		return;
+	}
+	Barrier barrier(bands, done);
+	int tiles = (rows + LIFE_TILE - 1) / LIFE_TILE;
+	auto work = [&](int band){
+		int begin = min(rows, tiles * band / bands * LIFE_TILE), end = min(rows, tiles * (band+1) / bands * LIFE_TILE);
+		for(int g = 0; g < generations; ++g){
+			step(begin, end, band);
+			barrier.wait();
+		}
+	};
+	pool.run(bands, work);
+}
+
+// --------
+// HashLife
+// --------
+
+// the most nodes a HashLife keeps before it throws away all but the board
+#define LIFE_HASHLIFE_NODES (1 << 22)
+
+// the fewest generations worth loading a board into a HashLife and storing it back for
+#define LIFE_HASHLIFE_LEAST 16
+
+/**
+* @brief A HashLife holds a board of ConwayCells as a quadtree whose equal subtrees are one shared node, and remembers for each node where its middle half will be some power of 2 generations on, so that a jump of 2^j generations costs about as much as one generation does on a board of bits.
+* The quadtree has no edges, so a jump is only like stepping a board whose edges stay dead while no live cell can reach an edge, see margin
+*/
+class HashLife {
+private:
+	struct Node {
+		Node* q[4]; // nw, ne, sw, se
+		int level;  // the node is 2^level cells on a side
+		long long pop;
+		Node* next; // the middle half, 2^step generations on
+		int step;
+		int edge[4]; // the first and last live rows and columns, -2 if not found yet
+
+		Node(Node* nw, Node* ne, Node* sw, Node* se, int level, long long pop);
+	};
+
+	struct Quad {
+		Node* q[4];
+		bool operator == (const Quad& rhs) const;
+	};
+
+	struct QuadHash {
+		size_t operator () (const Quad& k) const;
+	};
+
+	size_t limit;
+	deque<Node> nodes;
+	unordered_map<Quad, Node*, QuadHash> table;
+	vector<Node*> empties;
+	Node* cells[2];
+	Node* board = NULL; // holds the board in its northwest corner
+	int row = 0;
+	int col = 0;
+
+	Node* join(Node* nw, Node* ne, Node* sw, Node* se);
+	Node* empty(int level);
+	Node* next(Node* n, int j);
+	Node* base(Node* n);
+	Node* copy(Node* n, unordered_map<Node*, Node*>& done);
+	Node* build(const vector<uint64_t>& grid, int words, int level, int y, int x);
+	void write(Node* n, vector<uint64_t>& grid, int words, int y, int x) const;
+	int edge(Node* n, int k);
+	void reset();
+	void collect();
+
+public:
+
+	// --------
+	// HashLife Constructor
+	// --------
+
+	/**
+	* @brief The HashLife constructor takes in the most nodes to keep
+	* @param size_t limit: when a jump needs more nodes than this, all but those of the board are thrown away
+	*/
+	HashLife(size_t limit = LIFE_HASHLIFE_NODES);
+
+	// --------
+	// HashLife Copy Constructor
+	// --------
+
+	/**
+	* @brief The HashLife copy constructor makes its own nodes for the board of rhs, since the nodes of rhs go when it does
+	* @param const HashLife& rhs: the HashLife to copy
+	*/
+	HashLife(const HashLife& rhs);
+
+	// --------
+	// operator =
+	// --------
+
+	/**
+	* @brief This method throws away every node and makes its own for the board of rhs
+	* @param const HashLife& rhs: the HashLife to copy
+	* @return HashLife&: this
+	*/
+	HashLife& operator = (const HashLife& rhs);
+
+	// --------
+	// load
+	// --------
+
+	/**
+	* @brief This method replaces the board with a board of bits, one row after another, 64 cells to a word
+	* @param const vector<uint64_t>& grid: the bits
+	* @param int row, col: the size of the board
+	* @param int words: the words in a row
+	*/
+	void load(const vector<uint64_t>& grid, int row, int col, int words);
+
+	// --------
+	// store
+	// --------
+
+	/**
+	* @brief This method writes the board out as bits, laid out as for load
+	* @param vector<uint64_t>& grid: the bits, row * words of them
+	* @param int words: the words in a row
+	*/
+	void store(vector<uint64_t>& grid, int words);
+
+	// --------
+	// margin
+	// --------
+
+	/**
+	* @brief This method returns how many generations the board can go on before a live cell could be next to an edge, as no cell travels faster than one a generation
+	* @return int: the fewest rows or columns between a live cell and an edge, or -1 if every cell is dead
+	*/
+	int margin();
+
+	// --------
+	// jump
+	// --------
+
+	/**
+	* @brief This method moves the board up to 2^j generations on, as if there were no edges.
+	* Should the nodes run past the limit on the way, all but those of the board are thrown away and the jump starts over, half as far if that happens twice
+	* @param int j: no more than what margin allows, and less than the log of the board's size
+	* @return int: the power of 2 generations the board moved on, j or less
+	*/
+	int jump(int j);
+
+	// --------
+	// population
+	// --------
+
+	/**
+	* @brief This method returns the number of live cells on the board
+	* @return long long: the population
+	*/
+	long long population() const;
+
+	// --------
+	// size
+	// --------
+
+	/**
+	* @brief This method returns the number of nodes kept
+	* @return size_t: the nodes
+	*/
+	size_t size() const;
+};
+
 template <typename T>
 class Life{
 private:
@@ -235,61 +642,68 @@ private:
 	// int row;
 	// int col;
 	vector<vector<T>> grid;
+	vector<char> now;
+	vector<char> then;
+	Tiles tiles;
+	Bands workers; // the threads that step the bands past the first
 
 public:
 	int row;
 	int col;
 	int rounds = 0;
 	int intervals = 0;
+	int threads = 0; // 0 to pick by the size of the board
 
 	// --------
 	// do_turn
 	// --------
 
 	/**
-	* @brief This method will take the current generation to determine the states of every cell in the grid
+	* @brief This method will take the current generation to determine the states of every cell in the grid.
+	* Every cell reads its neighbors from the states of the last generation and writes its own into the next, so the rows can be split into bands, one thread each.
+	* Tiles that cannot change are skipped
 	* @param int current_generation: the given current generation to be used to determine states of the cells
 	*/
 	void do_turn(int current_generation){
+		if(gen >= current_generation)
+			return;
 		int r = grid.size(), c = grid[0].size();
-		for(; gen<current_generation; ++gen){
-			vector<AbstractCell*> buffer;
-			for(int i = 0; i < r; ++i){
-				for(int j = 0; j < c; ++j){
-					AbstractCell* neighbors[8] = {NULL};
-					if(j-1>=0){
-						if(i-1>=0){
-							neighbors[0] = &grid[i-1][j-1];
-						}
-						neighbors[3] = &grid[i][j-1];
-						if(i+1<r){
-							neighbors[5] = &grid[i+1][j-1];
-						}
+		int bands = life_bands(threads, (r + LIFE_TILE - 1) / LIFE_TILE, (long long)r * c);
+		vector<int> counts(bands);
+		ConwayCell live('*'), dead('.');
+		auto at = [&](const char* states, int j) -> AbstractCell* {
+			if(states == NULL || j < 0 || j >= c)
+				return NULL;
+			return states[j] ? &live : &dead;
+		};
+		in_bands(workers, bands, r, current_generation - gen, [&](int begin, int end, int band){
+			int p = 0;
+			tiles.each(begin / LIFE_TILE, (end + LIFE_TILE - 1) / LIFE_TILE, [&](int y, int t){
+				for(int i = y * LIFE_TILE; i < end && i < (y+1) * LIFE_TILE; ++i){
+					const char* up = i-1 >= 0 ? &now[(i-1)*c] : NULL;
+					const char* mid = &now[i*c];
+					const char* down = i+1 < r ? &now[(i+1)*c] : NULL;
+					for(int j = t * LIFE_TILE; j < c && j < (t+1) * LIFE_TILE; ++j){
+						AbstractCell* neighbors[8] = {at(up, j-1), at(up, j), at(up, j+1), at(mid, j-1), at(mid, j+1), at(down, j-1), at(down, j), at(down, j+1)};
+						T& cell = grid[i][j];
+						char before = cell.get_state();
+						if(cell.evolve(neighbors))
+							cell.change_state();
+						then[i*c+j] = cell.alive();
+						p += then[i*c+j] - mid[j];
+						if(cell.get_state() != before)
+							tiles.change(y, t);
 					}
-					if(i-1>=0)
-						neighbors[1] = &grid[i-1][j];
-					if(i+1<r)
-						neighbors[6] = &grid[i+1][j];
-					if(j+1<c){
-						if(i-1>=0)
-							neighbors[2] = &grid[i-1][j+1];
-						neighbors[4] = &grid[i][j+1];
-						if(i+1<r)
-							neighbors[7] = &grid[i+1][j+1];
-					}
-
-					if(grid[i][j].evolve(neighbors))
-						buffer.push_back(&grid[i][j]);
 				}
-			}
-			for(AbstractCell* to_change : buffer){
-				to_change->change_state();
-				if(to_change->alive())
-					++popu;
-				else
-					--popu;
-			}
-		}
+			});
+			counts[band] = p;
+		}, [&]{
+			now.swap(then);
+			for(int p : counts)
+				popu += p;
+			tiles.turn();
+			++gen;
+		});
 	}
 
 	// --------
@@ -302,7 +716,7 @@ public:
 	* @param int row: number of row
 	* @param int col: number of columns
 	*/
-	Life(istream& in, int row, int col){
+	Life(istream& in, int row, int col) : tiles(row, col, LIFE_TILE), row(row), col(col){
 		for(int i = 0; i < row; ++i){
 			grid.push_back(vector<T>());
 			for(int j = 0; j<col; ++j){
@@ -311,10 +725,12 @@ public:
 
 				T cell(tmp);
 				grid[i].push_back(cell);
+				now.push_back(cell.alive());
 				if(cell.alive())
 					++popu;
 			}
 		}
+		then.resize(now.size());
 	}
 
 	// --------
@@ -337,3 +753,414 @@ public:
 		out << endl;
 	}
 };
+
+// --------
+// Life<ConwayCell>
+// --------
+
+/**
+* @brief Life of only ConwayCells keeps one bit per cell, 64 cells to a word, and counts the neighbors of a whole word at once with bit sliced adders
+*/
+template <>
+class Life<ConwayCell>{
+private:
+	int popu = 0;
+	int gen = 0;
+	int words = 0;
+	vector<uint64_t> grid;
+	vector<uint64_t> next;
+	HashLife tree;
+	Tiles tiles;
+	Bands workers; // the threads that step the bands past the first
+
+	// --------
+	// add
+	// --------
+
+	/**
+	* @brief This method is a full adder over 64 columns at once, a half adder when c is 0
+	* @param uint64_t a, b, c: the bits to be added, one column per bit
+	* @param uint64_t& sum: the low bit of each column's sum
+	* @param uint64_t& carry: the high bit of each column's sum
+	*/
+	static void add(uint64_t a, uint64_t b, uint64_t c, uint64_t& sum, uint64_t& carry){
+		sum = a ^ b ^ c;
+		carry = (a & b) | (c & (a ^ b));
+	}
+
+	// --------
+	// margin
+	// --------
+
+	/**
+	* @brief This method returns how many generations the board can go on before a live cell could be next to an edge, as HashLife::margin does, but from the bits, so that a board that cannot jump is never loaded into the tree
+	* @return int: the fewest rows or columns between a live cell and an edge, or -1 if every cell is dead
+	*/
+	int margin() const{
+		uint64_t last = uint64_t(1) << ((col - 1) % 64);
+		int top = -1, bottom = -1;
+		vector<uint64_t> any(words);
+		for(int i = 0; i < row; ++i){
+			const uint64_t* r = &grid[i*words];
+			if((r[0] & 1) || (r[words-1] & last))
+				return 0;
+			uint64_t live = 0;
+			for(int w = 0; w < words; ++w){
+				live |= r[w];
+				any[w] |= r[w];
+			}
+			if(live == 0)
+				continue;
+			if(top < 0)
+				top = i;
+			bottom = i;
+		}
+		if(top < 0)
+			return -1;
+		int left = 0, right = words - 1;
+		while(any[left] == 0)
+			++left;
+		while(any[right] == 0)
+			--right;
+		left = left * 64 + __builtin_ctzll(any[left]);
+		right = right * 64 + 63 - __builtin_clzll(any[right]);
+		return min(min(top, left), min(row - 1 - bottom, col - 1 - right));
+	}
+
+	// --------
+	// step
+	// --------
+
+	/**
+	* @brief This method computes one word of the next generation from the three rows around it, which are NULL past the edges of the grid
+	* @param const uint64_t* up, mid, down: the rows above, at and below the word
+	* @param int w: the index of the word in its row
+	* @return uint64_t: the word of the next generation
+	*/
+	uint64_t step(const uint64_t* up, const uint64_t* mid, const uint64_t* down, int w){
+		uint64_t n[3][3] = {{0}};
+		const uint64_t* rows[3] = {up, mid, down};
+		for(int k = 0; k < 3; ++k){
+			if(rows[k] == NULL)
+				continue;
+			uint64_t x = rows[k][w];
+			uint64_t before = w > 0 ? rows[k][w-1] : 0;
+			uint64_t after = w+1 < words ? rows[k][w+1] : 0;
+			n[k][0] = (x << 1) | (before >> 63);
+			n[k][1] = x;
+			n[k][2] = (x >> 1) | (after << 63);
+		}
+		uint64_t s0, c0, s1, c1, s2, c2, ones, c3, twos, c4, c5;
+		add(n[0][0], n[0][1], n[0][2], s0, c0);
+		add(n[1][0], n[1][2], n[2][0], s1, c1);
+		add(n[2][1], n[2][2], 0, s2, c2);
+		add(s0, s1, s2, ones, c3);
+		add(c0, c1, c2, twos, c4);
+		add(twos, c3, 0, twos, c5);
+		uint64_t fours = c4 ^ c5;
+		return twos & ~fours & (ones | n[1][1]);
+	}
+
+public:
+	int row;
+	int col;
+	int rounds = 0;
+	int intervals = 0;
+	int threads = 0; // 0 to pick by the size of the board
+	bool hashlife = false;
+
+	// --------
+	// do_turn
+	// --------
+
+	/**
+	* @brief This method will take the current generation to determine the states of every cell in the grid.
+	* With hashlife set, it jumps as far as it can in powers of 2 generations while no live cell can reach an edge, and steps the rest of the way.
+	* The board is only loaded into the tree when it can jump at least LIFE_HASHLIFE_LEAST generations
+	* A step skips the tiles, LIFE_TILE rows of a word each, that cannot change
+	* @param int current_generation: the given current generation to be used to determine states of the cells
+	*/
+	void do_turn(int current_generation){
+		if(hashlife && gen < current_generation){
+			int m = margin();
+			if(m < 0)
+				gen = current_generation;
+			else if(min(m, current_generation - gen) >= LIFE_HASHLIFE_LEAST){
+				tree.load(grid, row, col, words);
+				while(gen < current_generation){
+					m = tree.margin();
+					if(m < 0){
+						gen = current_generation;
+						break;
+					}
+					if(m == 0)
+						break;
+					int j = 0;
+					while(j < 30 && (2 << j) <= min(m, current_generation - gen))
+						++j;
+					gen += 1 << tree.jump(j);
+				}
+				tree.store(grid, words);
+				popu = tree.population();
+				tiles.wake();
+			}
+		}
+		if(gen >= current_generation)
+			return;
+		uint64_t last = col % 64 == 0 ? ~uint64_t(0) : (uint64_t(1) << (col % 64)) - 1;
+		int bands = life_bands(threads, (row + LIFE_TILE - 1) / LIFE_TILE, (long long)row * words);
+		vector<int> counts(bands);
+		in_bands(workers, bands, row, current_generation - gen, [&](int begin, int end, int band){
+			int p = 0;
+			tiles.each(begin / LIFE_TILE, (end + LIFE_TILE - 1) / LIFE_TILE, [&](int y, int w){
+				bool changed = false;
+				for(int i = y * LIFE_TILE; i < end && i < (y+1) * LIFE_TILE; ++i){
+					const uint64_t* up = i-1 >= 0 ? &grid[(i-1)*words] : NULL;
+					const uint64_t* down = i+1 < row ? &grid[(i+1)*words] : NULL;
+					uint64_t x = step(up, &grid[i*words], down, w);
+					if(w == words-1)
+						x &= last;
+					uint64_t before = grid[i*words+w];
+					next[i*words+w] = x;
+					if(x != before){
+						p += __builtin_popcountll(x) - __builtin_popcountll(before);
+						changed = true;
+					}
+				}
+				if(changed)
+					tiles.change(y, w);
+			});
+			counts[band] = p;
+		}, [&]{
+			grid.swap(next);
+			for(int p : counts)
+				popu += p;
+			tiles.turn();
+			++gen;
+		});
+	}
+
+	// --------
+	// Life constructor
+	// --------
+
+	/**
+	* @brief The constructor for life takes in an input stream and parses through to create the grid of cells
+	* @param istream& in: input stream containing the grid layout given to the function
+	* @param int row: number of row
+	* @param int col: number of columns
+	*/
+	Life(istream& in, int row, int col) : words((col + 63) / 64), grid(row * words), next(row * words), tiles(row, words, 1), row(row), col(col){
+		for(int i = 0; i < row; ++i){
+			for(int j = 0; j < col; ++j){
+				char tmp;
+				in >> tmp;
+				if(ConwayCell(tmp).alive()){
+					grid[i*words + j/64] |= uint64_t(1) << (j % 64);
+					++popu;
+				}
+			}
+		}
+	}
+
+	// --------
+	// print
+	// --------
+
+	/**
+	* @brief This method prints out the current generation and popuulation followed by the grid of cells
+	* @param int gen: the current generation of life
+	* @param ostream& out: output stream to be used
+	*/
+	void print(int gen, ostream& out){
+		out << "Generation = " << gen << ", Population = " << popu << "." << endl;
+		string line(col, '.');
+		for(int i = 0; i < row; ++i){
+			for(int j = 0; j < col; ++j)
+				line[j] = (grid[i*words + j/64] >> (j % 64)) & 1 ? '*' : '.';
+			out << line << '\n';
+		}
+		out << endl;
+	}
+};
+
+// --------
+// Life<Cell>
+// --------
+
+/**
+* @brief Life of Cells keeps the kind of every cell in one array, whether it is alive in a bitmap, 64 cells to a word, and the age of its FredkinCell in another, and steps each cell by switching on its kind, with no cell objects and no virtual calls
+*/
+template <>
+class Life<Cell>{
+private:
+	enum Kind {CONWAY, FREDKIN};
+
+	// ages past this all print as '+'
+	static const int OLD = 10;
+
+	int popu = 0;
+	int gen = 0;
+	int words = 0;
+	vector<char> kind;
+	vector<uint64_t> now;
+	vector<uint64_t> then;
+	vector<unsigned char> age;
+	Tiles tiles;
+	Bands workers; // the threads that step the bands past the first
+
+	// --------
+	// alive
+	// --------
+
+	/**
+	* @brief This method returns whether a cell of a row of the bitmap is alive
+	* @param const uint64_t* states: the row, NULL past the edges of the grid
+	* @param int j: the column, which may be past the edges of the grid
+	* @return int: 1 if alive and 0 otherwise
+	*/
+	int alive(const uint64_t* states, int j){
+		if(states == NULL || j < 0 || j >= col)
+			return 0;
+		return (states[j/64] >> (j % 64)) & 1;
+	}
+
+public:
+	int row;
+	int col;
+	int rounds = 0;
+	int intervals = 0;
+	int threads = 0; // 0 to pick by the size of the board
+
+	// --------
+	// do_turn
+	// --------
+
+	/**
+	* @brief This method will take the current generation to determine the states of every cell in the grid.
+	* A ConwayCell counts all 8 neighbors, a FredkinCell only the 4 beside it, and a FredkinCell that goes from age 1 to 2 becomes a live ConwayCell.
+	* A step skips the tiles, LIFE_TILE rows of a word each, in which no cell can change how it prints
+	* @param int current_generation: the given current generation to be used to determine states of the cells
+	*/
+	void do_turn(int current_generation){
+		if(gen >= current_generation)
+			return;
+		int bands = life_bands(threads, (row + LIFE_TILE - 1) / LIFE_TILE, (long long)row * col);
+		vector<int> counts(bands);
+		in_bands(workers, bands, row, current_generation - gen, [&](int begin, int end, int band){
+			int p = 0;
+			tiles.each(begin / LIFE_TILE, (end + LIFE_TILE - 1) / LIFE_TILE, [&](int y, int w){
+				for(int i = y * LIFE_TILE; i < end && i < (y+1) * LIFE_TILE; ++i){
+					const uint64_t* up = i-1 >= 0 ? &now[(i-1)*words] : NULL;
+					const uint64_t* mid = &now[i*words];
+					const uint64_t* down = i+1 < row ? &now[(i+1)*words] : NULL;
+					uint64_t x = 0;
+					bool changed = false;
+					for(int j = w*64; j < col && j < (w+1)*64; ++j){
+						int k = i*col + j;
+						int beside = alive(up, j) + alive(mid, j-1) + alive(mid, j+1) + alive(down, j);
+						bool was = alive(mid, j), is;
+						switch(kind[k]){
+						case CONWAY:{
+							int count = beside + alive(up, j-1) + alive(up, j+1) + alive(down, j-1) + alive(down, j+1);
+							is = count == 3 || (was && count == 2);
+							break;
+						}
+						default:
+							is = beside % 2 == 1;
+							if(was && !is)
+								age[k] = 0;
+							else if(was){
+								if(age[k] == 1)
+									kind[k] = CONWAY;
+								if(age[k] < OLD){
+									++age[k];
+									changed = true;
+								}
+							}
+						}
+						if(is)
+							x |= uint64_t(1) << (j % 64);
+					}
+					uint64_t before = mid[w];
+					then[i*words+w] = x;
+					if(changed || x != before){
+						p += __builtin_popcountll(x) - __builtin_popcountll(before);
+						tiles.change(y, w);
+					}
+				}
+			});
+			counts[band] = p;
+		}, [&]{
+			now.swap(then);
+			for(int p : counts)
+				popu += p;
+			tiles.turn();
+			++gen;
+		});
+	}
+
+	// --------
+	// Life constructor
+	// --------
+
+	/**
+	* @brief The constructor for life takes in an input stream and parses through to create the grid of cells
+	* @param istream& in: input stream containing the grid layout given to the function
+	* @param int row: number of row
+	* @param int col: number of columns
+	*/
+	Life(istream& in, int row, int col) : words((col + 63) / 64), kind(row * col), now(row * words), then(row * words), age(row * col), tiles(row, words, 1), row(row), col(col){
+		for(int i = 0; i < row; ++i){
+			for(int j = 0; j < col; ++j){
+				char tmp;
+				in >> tmp;
+				int k = i*col + j;
+				bool is;
+				if(tmp == '*' || tmp == '.'){
+					kind[k] = CONWAY;
+					is = ConwayCell(tmp).alive();
+				}
+				else{
+					FredkinCell cell(tmp);
+					char s = cell.get_state();
+					kind[k] = FREDKIN;
+					is = cell.alive();
+					age[k] = s == '+' ? OLD : s == '-' ? 0 : s - '0';
+				}
+				if(is){
+					now[i*words + j/64] |= uint64_t(1) << (j % 64);
+					++popu;
+				}
+			}
+		}
+	}
+
+	// --------
+	// print
+	// --------
+
+	/**
+	* @brief This method prints out the current generation and popuulation followed by the grid of cells
+	* @param int gen: the current generation of life
+	* @param ostream& out: output stream to be used
+	*/
+	void print(int gen, ostream& out){
+		out << "Generation = " << gen << ", Population = " << popu << "." << endl;
+		string line(col, '.');
+		for(int i = 0; i < row; ++i){
+			const uint64_t* states = &now[i*words];
+			for(int j = 0; j < col; ++j){
+				int k = i*col + j;
+				if(kind[k] == CONWAY)
+					line[j] = alive(states, j) ? '*' : '.';
+				else if(!alive(states, j))
+					line[j] = '-';
+				else
+					line[j] = age[k] >= OLD ? '+' : '0' + age[k];
+			}
+			out << line << '\n';
+		}
+		out << endl;
+	}
+};
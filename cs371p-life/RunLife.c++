@@ -23,10 +23,10 @@ int main() {
 
         if (type == "ConwayCell") {
             Life<ConwayCell> con1(cin, row, col);
+            con1.hashlife = true;
             cout << "*** Life<ConwayCell> " << row << "x" << col << " ***\n" << endl;
-            for (int i = 0; i <= rounds; i++) {
+            for (int i = 0; i <= rounds; i += intervals) {
                 con1.do_turn(i);
-                if (i % intervals == 0)
                 con1.print(i,cout);
             }
             cout << "...\n" << endl;
@@ -34,18 +34,16 @@ int main() {
             Life<FredkinCell> con2(cin, row, col);
             cout << "*** Life<FredkinCell> " << row << "x" << col << " ***\n" << endl;
 
-            for (int i = 0; i <= rounds; i++) {
+            for (int i = 0; i <= rounds; i += intervals) {
                 con2.do_turn(i);
-                if (i % intervals == 0)
                 con2.print(i,cout);
             }
             cout << "...\n" << endl;
         } else {
             Life<Cell> con3(cin, row, col);
             cout << "*** Life<Cell> " << row << "x" << col << " ***\n" << endl;
-            for (int i = 0; i <= rounds; i++) {
+            for (int i = 0; i <= rounds; i += intervals) {
                 con3.do_turn(i);
-                if (i % intervals == 0)
                 con3.print(i,cout);
             }
             cout << "...\n" << endl;
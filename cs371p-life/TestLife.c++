@@ -1,9 +1,11 @@
 #include <algorithm> // sort
+#include <cstdlib>   // abs, rand, srand
 #include <iostream>  // cout, endl
 #include <iterator>  // equal
 #include <sstream>   // istringtstream, ostringstream
 #include <string>    // compare, string
 #include <utility>   // pair
+#include <vector>    // vector
 #include "gtest/gtest.h"
 
 #include "Life.h"
@@ -736,4 +738,382 @@ TEST(LifeFixture, Life_do_turn_9) {
 	stringstream out;
 	life.print(3, out);
 	ASSERT_EQ("Generation = 3, Population = 32.\n--------------------\n--------------------\n--------------------\n--------------------\n--------------------\n--------------------\n---------00---------\n--------------------\n---------**---------\n--------1001--------\n-----01*....*10-----\n------000**000------\n-------011110-------\n--------0000--------\n--------------------\n--------------------\n--------------------\n--------------------\n--------------------\n--------------------\n\n", out.str());
-}
\ No newline at end of file
+}
+// ----------
+// Test Life<ConwayCell>
+// ----------
+
+// a board of ConwayCells, . and * at random
+string random_conway(int row, int col, unsigned seed){
+	string s;
+	srand(seed);
+	for(int i = 0; i < row; ++i){
+		for(int j = 0; j < col; ++j)
+			s += rand() % 3 == 0 ? '*' : '.';
+		s += '\n';
+	}
+	return s;
+}
+
+// the grid printed after each of n generations, with the heading line left out
+template <typename T>
+vector<string> run_grids(const string& board, int row, int col, int n){
+	stringstream in(board);
+	Life<T> life(in, row, col);
+	vector<string> grids;
+	for(int i = 1; i <= n; ++i){
+		life.do_turn(i);
+		stringstream out;
+		life.print(i, out);
+		string s = out.str();
+		grids.push_back(s.substr(s.find('\n')));
+	}
+	return grids;
+}
+
+TEST(LifeFixture, Life_conway_bits_1) {
+	stringstream in("3\n130\n" + string(62, '.') + "***" + string(65, '.') + "\n" + string(130, '.') + "\n" + string(129, '.') + "*\n");
+	int row = 0;
+	int col = 0;
+	in >> row;
+	in >> col;
+	Life<ConwayCell> life(in,row,col);
+	life.do_turn(1);
+	stringstream out;
+	life.print(1, out);
+	ASSERT_EQ("Generation = 1, Population = 2.\n" + string(63, '.') + "*" + string(66, '.') + "\n" + string(63, '.') + "*" + string(66, '.') + "\n" + string(130, '.') + "\n\n", out.str());
+}
+
+TEST(LifeFixture, Life_conway_bits_2) {
+	string board = random_conway(37, 130, 371);
+	vector<string> bits = run_grids<ConwayCell>(board, 37, 130, 40);
+	vector<string> cells = run_grids<Cell>(board, 37, 130, 40);
+	ASSERT_TRUE(bits == cells);
+}
+
+TEST(LifeFixture, Life_conway_bits_3) {
+	string board = random_conway(64, 64, 17);
+	vector<string> bits = run_grids<ConwayCell>(board, 64, 64, 40);
+	vector<string> cells = run_grids<Cell>(board, 64, 64, 40);
+	ASSERT_TRUE(bits == cells);
+}
+
+// ----------
+// Test bands
+// ----------
+
+// a board of FredkinCells, - and 0 at random
+string random_fredkin(int row, int col, unsigned seed){
+	string s;
+	srand(seed);
+	for(int i = 0; i < row; ++i){
+		for(int j = 0; j < col; ++j)
+			s += rand() % 4 == 0 ? '0' : '-';
+		s += '\n';
+	}
+	return s;
+}
+
+// the board printed after n generations with the rows split into the given number of bands
+template <typename T>
+string run_bands(const string& board, int row, int col, int n, int threads){
+	stringstream in(board);
+	Life<T> life(in, row, col);
+	life.threads = threads;
+	life.do_turn(n);
+	stringstream out;
+	life.print(n, out);
+	return out.str();
+}
+
+TEST(LifeFixture, Life_bands_1) {
+	ASSERT_EQ(1, life_bands(0, 100, 100 * 100));
+	ASSERT_EQ(3, life_bands(3, 100, 100));
+	ASSERT_EQ(2, life_bands(8, 2, 100));
+}
+
+TEST(LifeFixture, Life_bands_2) {
+	string board = random_conway(45, 130, 5);
+	string one = run_bands<ConwayCell>(board, 45, 130, 30, 1);
+	ASSERT_EQ(one, run_bands<ConwayCell>(board, 45, 130, 30, 4));
+	ASSERT_EQ(one, run_bands<ConwayCell>(board, 45, 130, 30, 45));
+}
+
+TEST(LifeFixture, Life_bands_3) {
+	string board = random_fredkin(40, 50, 7);
+	string one = run_bands<FredkinCell>(board, 40, 50, 12, 1);
+	ASSERT_EQ(one, run_bands<FredkinCell>(board, 40, 50, 12, 3));
+}
+
+TEST(LifeFixture, Life_bands_4) {
+	string board = random_fredkin(40, 50, 9);
+	string one = run_bands<Cell>(board, 40, 50, 12, 1);
+	ASSERT_EQ(one, run_bands<Cell>(board, 40, 50, 12, 5));
+}
+
+// the same workers step every call, and a copy of the board starts its own
+TEST(LifeFixture, Life_bands_5) {
+	string board = random_conway(45, 130, 11);
+	stringstream in(board);
+	Life<ConwayCell> life(in, 45, 130);
+	life.threads = 4;
+	for(int g = 1; g <= 15; ++g)
+		life.do_turn(g);
+	Life<ConwayCell> copy = life;
+	for(int g = 16; g <= 30; ++g){
+		life.do_turn(g);
+		copy.do_turn(g);
+	}
+	stringstream a, b;
+	life.print(30, a);
+	copy.print(30, b);
+	ASSERT_EQ(run_bands<ConwayCell>(board, 45, 130, 30, 1), a.str());
+	ASSERT_EQ(a.str(), b.str());
+}
+
+// ----------
+// Test Life<Cell>
+// ----------
+
+// a board of Cells, ConwayCells on the left and FredkinCells of any age on the right
+string random_cells(int row, int col, unsigned seed){
+	string s;
+	srand(seed);
+	for(int i = 0; i < row; ++i){
+		for(int j = 0; j < col; ++j){
+			if(j < col / 3)
+				s += rand() % 3 == 0 ? '*' : '.';
+			else
+				s += "--0123456789+"[rand() % 13];
+		}
+		s += '\n';
+	}
+	return s;
+}
+
+// the grids printed after each of n generations, stepped one cell at a time
+template <typename T>
+vector<string> cell_grids(const string& board, int row, int col, int n){
+	stringstream in(board);
+	vector<vector<T>> grid(row);
+	for(int i = 0; i < row; ++i){
+		for(int j = 0; j < col; ++j){
+			char tmp;
+			in >> tmp;
+			grid[i].push_back(T(tmp));
+		}
+	}
+	vector<string> grids;
+	for(int g = 1; g <= n; ++g){
+		vector<AbstractCell*> changed;
+		for(int i = 0; i < row; ++i){
+			for(int j = 0; j < col; ++j){
+				AbstractCell* neighbors[8] = {NULL};
+				int k = 0;
+				for(int di = -1; di <= 1; ++di){
+					for(int dj = -1; dj <= 1; ++dj){
+						if(di == 0 && dj == 0)
+							continue;
+						if(i+di >= 0 && i+di < row && j+dj >= 0 && j+dj < col)
+							neighbors[k] = &grid[i+di][j+dj];
+						++k;
+					}
+				}
+				if(grid[i][j].evolve(neighbors))
+					changed.push_back(&grid[i][j]);
+			}
+		}
+		for(AbstractCell* c : changed)
+			c->change_state();
+		string s = "\n";
+		for(int i = 0; i < row; ++i){
+			for(int j = 0; j < col; ++j)
+				s += grid[i][j].get_state();
+			s += '\n';
+		}
+		grids.push_back(s + "\n");
+	}
+	return grids;
+}
+
+TEST(LifeFixture, Life_cell_1) {
+	string board = random_cells(30, 70, 11);
+	ASSERT_TRUE(run_grids<Cell>(board, 30, 70, 25) == cell_grids<Cell>(board, 30, 70, 25));
+}
+
+TEST(LifeFixture, Life_cell_2) {
+	string board = random_cells(20, 130, 13);
+	ASSERT_TRUE(run_grids<Cell>(board, 20, 130, 25) == cell_grids<Cell>(board, 20, 130, 25));
+}
+
+TEST(LifeFixture, Life_cell_3) {
+	stringstream in("1\n5\n-11-.\n");
+	int row = 0;
+	int col = 0;
+	in >> row;
+	in >> col;
+	Life<Cell> life(in,row,col);
+	life.do_turn(1);
+	stringstream out;
+	life.print(1, out);
+	ASSERT_EQ("Generation = 1, Population = 4.\n0**0.\n\n", out.str());
+}
+
+// ----------
+// Test HashLife
+// ----------
+
+// a board with a few cells in the middle, at random, and dead all around them
+string middle_conway(int row, int col, int side, unsigned seed){
+	string s;
+	srand(seed);
+	for(int i = 0; i < row; ++i){
+		for(int j = 0; j < col; ++j){
+			bool in = abs(i - row / 2) < side && abs(j - col / 2) < side;
+			s += in && rand() % 2 == 0 ? '*' : '.';
+		}
+		s += '\n';
+	}
+	return s;
+}
+
+// the boards printed at every interval up to n generations, jumping or stepping
+vector<string> run_hashlife(const string& board, int row, int col, int n, int interval, bool hashlife){
+	stringstream in(board);
+	Life<ConwayCell> life(in, row, col);
+	life.hashlife = hashlife;
+	vector<string> boards;
+	for(int i = 0; i <= n; i += interval){
+		life.do_turn(i);
+		stringstream out;
+		life.print(i, out);
+		boards.push_back(out.str());
+	}
+	return boards;
+}
+
+TEST(LifeFixture, Life_hashlife_1) {
+	string board = middle_conway(200, 150, 4, 3);
+	ASSERT_TRUE(run_hashlife(board, 200, 150, 600, 37, true) == run_hashlife(board, 200, 150, 600, 37, false));
+}
+
+TEST(LifeFixture, Life_hashlife_2) {
+	string board = middle_conway(40, 90, 3, 21);
+	ASSERT_TRUE(run_hashlife(board, 40, 90, 300, 1, true) == run_hashlife(board, 40, 90, 300, 1, false));
+}
+
+TEST(LifeFixture, Life_hashlife_3) {
+	string board = middle_conway(128, 128, 5, 8);
+	stringstream in(board);
+	Life<ConwayCell> life(in, 128, 128);
+	vector<uint64_t> grid(128 * 2), bits(128 * 2);
+	for(int i = 0; i < 128; ++i)
+		for(int j = 0; j < 128; ++j)
+			if(board[i * 129 + j] == '*')
+				grid[i * 2 + j / 64] |= uint64_t(1) << (j % 64);
+	HashLife tree(300);
+	tree.load(grid, 128, 128, 2);
+	int gen = 0;
+	while(gen < 400 && tree.margin() >= 32){
+		int j = tree.jump(5);
+		ASSERT_TRUE(j >= 0 && j <= 5);
+		gen += 1 << j;
+		ASSERT_TRUE(tree.size() <= 300);
+	}
+	ASSERT_TRUE(gen > 0);
+	tree.store(bits, 2);
+	life.do_turn(gen);
+	stringstream out;
+	life.print(gen, out);
+	string s = out.str();
+	s = s.substr(s.find('\n') + 1);
+	for(int i = 0; i < 128; ++i)
+		for(int j = 0; j < 128; ++j)
+			ASSERT_EQ(s[i * 129 + j] == '*', ((bits[i * 2 + j / 64] >> (j % 64)) & 1) == 1);
+	ASSERT_EQ(count(s.begin(), s.end(), '*'), tree.population());
+}
+
+TEST(LifeFixture, Life_hashlife_4) {
+	stringstream in("3\n3\n...\n...\n...\n");
+	int row = 0;
+	int col = 0;
+	in >> row;
+	in >> col;
+	Life<ConwayCell> life(in,row,col);
+	life.hashlife = true;
+	life.do_turn(1000000000);
+	stringstream out;
+	life.print(1000000000, out);
+	ASSERT_EQ("Generation = 1000000000, Population = 0.\n...\n...\n...\n\n", out.str());
+}
+
+TEST(LifeFixture, Life_hashlife_5) {
+	string board = random_conway(90, 140, 24);
+	ASSERT_TRUE(run_hashlife(board, 90, 140, 200, 9, true) == run_hashlife(board, 90, 140, 200, 9, false));
+}
+
+TEST(LifeFixture, Life_hashlife_6) {
+	string board = middle_conway(128, 128, 5, 8);
+	stringstream in(board);
+	Life<ConwayCell>* first = new Life<ConwayCell>(in, 128, 128);
+	first->hashlife = true;
+	first->do_turn(100);
+	Life<ConwayCell> copied(*first);
+	Life<ConwayCell> assigned = copied;
+	assigned = *first;
+	delete first;
+	copied.do_turn(1000);
+	assigned.do_turn(1000);
+	stringstream a, b;
+	copied.print(1000, a);
+	assigned.print(1000, b);
+	vector<string> stepped = run_hashlife(board, 128, 128, 1000, 1000, false);
+	ASSERT_EQ(stepped[1], a.str());
+	ASSERT_EQ(stepped[1], b.str());
+}
+
+// ----------
+// Test Tiles
+// ----------
+
+TEST(LifeFixture, Life_tiles_1) {
+	Tiles tiles(40, 5, 1);
+	ASSERT_EQ(15, tiles.active());
+	tiles.turn();
+	ASSERT_EQ(0, tiles.active());
+	tiles.wake();
+	ASSERT_EQ(15, tiles.active());
+	tiles.change(0, 4);
+	tiles.turn();
+	ASSERT_EQ(4, tiles.active());
+	ASSERT_FALSE(tiles.asleep(1, 3));
+	ASSERT_TRUE(tiles.asleep(0, 2));
+	vector<int> seen;
+	tiles.each(0, 3, [&](int i, int j){ seen.push_back(i * 5 + j); });
+	ASSERT_TRUE(seen == vector<int>({3, 4, 8, 9}));
+	seen.clear();
+	tiles.each(1, 3, [&](int i, int j){ seen.push_back(i * 5 + j); });
+	ASSERT_TRUE(seen == vector<int>({8, 9}));
+}
+
+TEST(LifeFixture, Life_tiles_2) {
+	string board = random_fredkin(50, 70, 19);
+	ASSERT_TRUE(run_grids<FredkinCell>(board, 50, 70, 40) == cell_grids<FredkinCell>(board, 50, 70, 40));
+}
+
+TEST(LifeFixture, Life_tiles_3) {
+	string board = random_cells(50, 200, 23);
+	ASSERT_TRUE(run_grids<Cell>(board, 50, 200, 60) == cell_grids<Cell>(board, 50, 200, 60));
+}
+
+TEST(LifeFixture, Life_tiles_4) {
+	// blocks in every tile and a glider going through them
+	string board;
+	for(int i = 0; i < 64; ++i){
+		for(int j = 0; j < 192; ++j)
+			board += i % 16 >= 7 && i % 16 <= 8 && j % 64 >= 40 && j % 64 <= 41 ? '*' : '.';
+		board += '\n';
+	}
+	board[1 * 193 + 2] = board[2 * 193 + 3] = board[3 * 193 + 1] = board[3 * 193 + 2] = board[3 * 193 + 3] = '*';
+	ASSERT_TRUE(run_grids<ConwayCell>(board, 64, 192, 120) == cell_grids<ConwayCell>(board, 64, 192, 120));
+}